@@ -3,6 +3,10 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <bit>
 
 struct Position
 {
@@ -35,6 +39,16 @@ public:
         return position;
     }
 
+    Orientation getOrientation()
+    {
+        return orientation;
+    }
+
+    void teleportTo(Position newPosition)
+    {
+        position = newPosition;
+    }
+
     Position getNextPosition()
     {
         switch (orientation)
@@ -68,10 +82,12 @@ private:
     Orientation orientation = Orientation::NORTH;
 };
 
+// Tiles are stored row by row with a border of ILLEGAL tiles around the board,
+// so looking one step off the edge never needs a bounds check.
 class Board
 {
 public:
-    enum class Tile
+    enum class Tile : uint8_t
     {
         ILLEGAL,
         EMPTY,
@@ -88,28 +104,35 @@ public:
             return;
         }
 
+        std::vector<std::string> lines;
         std::string line;
-        for (int y = 0; std::getline(file, line); y++)
+        while (std::getline(file, line))
         {
-            std::vector<Tile> row;
+            lines.push_back(line);
+        }
 
-            for (int x = 0; x < line.length(); x++)
+        boardHeight = lines.size();
+        boardWidth = lines.empty() ? 0 : lines[0].length();
+        stride = boardWidth + 2;
+        tiles.assign(stride * (boardHeight + 2), Tile::ILLEGAL);
+
+        for (int y = 0; y < boardHeight; y++)
+        {
+            for (int x = 0; x < boardWidth; x++)
             {
-                switch (line[x])
+                switch (lines[y][x])
                 {
                     case '^':
                         initialGuardPosition = {x, y};
                         // fall through
                     case '.':
-                        row.push_back(Tile::EMPTY);
+                        setTileAt({x, y}, Tile::EMPTY);
                         break;
                     case '#':
-                        row.push_back(Tile::OBSTRUCTION);
+                        setTileAt({x, y}, Tile::OBSTRUCTION);
                         break;
                 }
             }
-
-            board.push_back(row);
         }
 
         initVisited();
@@ -121,58 +144,225 @@ public:
         return initialGuardPosition;
     }
 
+    // valid for any position on the board or directly next to it
     Tile at(Position pos)
     {
-        if (pos.x < 0 || pos.x >= width() || pos.y < 0 || pos.y >= height())
-            return Tile::ILLEGAL;
-        
-        return board[pos.y][pos.x];
+        return tiles[tileIndex(pos)];
     }
 
     void setTileAt(Position pos, Tile newTile)
     {
-        board[pos.y][pos.x] = newTile;
+        tiles[tileIndex(pos)] = newTile;
     }
 
     void visit(Position pos)
     {
-        if (at(pos) == Tile::ILLEGAL)
-            return;
-        
-        visited[pos.y][pos.x] = true;
+        const size_t idx = pos.y * boardWidth + pos.x;
+        visited[idx / 64] |= uint64_t(1) << (idx % 64);
     }
 
     int getNumberOfVisitedTiles()
     {
         int sum = 0;
-        for (int y = 0; y < height(); y++)
+        for (uint64_t word : visited)
         {
-            sum += std::count(visited[y].begin(), visited[y].end(), true);
+            sum += std::popcount(word);
         }
         return sum;
     }
 
+    std::vector<Position> getVisitedPositions()
+    {
+        std::vector<Position> positions;
+        for (size_t w = 0; w < visited.size(); w++)
+        {
+            for (uint64_t word = visited[w]; word != 0; word &= word - 1)
+            {
+                const int idx = w * 64 + std::countr_zero(word);
+                positions.push_back({ idx % boardWidth, idx / boardWidth });
+            }
+        }
+        return positions;
+    }
+
     int width()
     {
-        return board[0].size();
+        return boardWidth;
     }
 
     int height()
     {
-        return board.size();
+        return boardHeight;
     }
 
 private:
+    size_t tileIndex(Position pos) const
+    {
+        return (pos.y + 1) * stride + (pos.x + 1);
+    }
+
     void initVisited()
     {
-        visited = std::vector<std::vector<bool>>(height(), std::vector<bool>(width(), false));
+        visited.assign((boardWidth * boardHeight + 63) / 64, 0);
     }
 
-    std::vector<std::vector<Tile>> board;
-    std::vector<std::vector<bool>> visited;
+    std::vector<Tile> tiles;
+    std::vector<uint64_t> visited;
+    int boardWidth = 0;
+    int boardHeight = 0;
+    int stride = 0;
     Position initialGuardPosition;
 };
 
+// For every cell and direction, stores the index of the cell where the guard
+// would stop in front of an obstruction, or EXIT if it walks off the board.
+class JumpTable
+{
+public:
+    static constexpr int EXIT = -1;
+
+    void build(Board& board)
+    {
+        width = board.width();
+        height = board.height();
+
+        for (int d = 0; d < NUM_DIRECTIONS; d++)
+        {
+            const Position delta = DELTAS[d];
+            stops[d].assign(width * height, EXIT);
+
+            // walk each line against the direction of travel,
+            // so the answer for the cell ahead is always already known
+            for (int j = 0; j < height; j++)
+            {
+                for (int i = 0; i < width; i++)
+                {
+                    const Position pos = { delta.x > 0 ? width - 1 - i : i, delta.y > 0 ? height - 1 - j : j };
+                    const Position ahead = { pos.x + delta.x, pos.y + delta.y };
+
+                    switch (board.at(ahead))
+                    {
+                        case Board::Tile::ILLEGAL:
+                            stops[d][indexOf(pos)] = EXIT;
+                            break;
+                        case Board::Tile::OBSTRUCTION:
+                            stops[d][indexOf(pos)] = indexOf(pos);
+                            break;
+                        case Board::Tile::EMPTY:
+                            stops[d][indexOf(pos)] = stops[d][indexOf(ahead)];
+                            break;
+                    }
+                }
+            }
+        }
+    }
+
+    int stopFrom(Position pos, Orientation orientation) const
+    {
+        return stops[static_cast<int>(orientation)][indexOf(pos)];
+    }
+
+    Position positionOf(int index) const
+    {
+        return { index % width, index / width };
+    }
+
+    // Same as above, but with one extra obstruction overlaid on the board.
+    // The table itself is never modified, so it can be shared between threads.
+    int stopFrom(Position pos, Orientation orientation, Position extraObstruction) const
+    {
+        const int stop = stopFrom(pos, orientation);
+        const Position delta = DELTAS[static_cast<int>(orientation)];
+
+        const int dx = extraObstruction.x - pos.x;
+        const int dy = extraObstruction.y - pos.y;
+
+        const bool isInLine = delta.x != 0 ? dy == 0 : dx == 0;
+        const int distance = dx * delta.x + dy * delta.y;
+
+        if (!isInLine || distance <= 0)
+            return stop;
+
+        if (stop != EXIT)
+        {
+            const Position stopPos = positionOf(stop);
+            const int stopDistance = (stopPos.x - pos.x) * delta.x + (stopPos.y - pos.y) * delta.y;
+
+            if (distance > stopDistance)
+                return stop;
+        }
+
+        return indexOf({ extraObstruction.x - delta.x, extraObstruction.y - delta.y });
+    }
+
+private:
+    static constexpr int NUM_DIRECTIONS = 4;
+    static constexpr Position DELTAS[NUM_DIRECTIONS] = {
+        {  0, -1 }, // NORTH
+        {  1,  0 }, // EAST
+        {  0,  1 }, // SOUTH
+        { -1,  0 }, // WEST
+    };
+
+    int indexOf(Position pos) const
+    {
+        return pos.y * width + pos.x;
+    }
+
+    std::vector<int> stops[NUM_DIRECTIONS];
+    int width = 0;
+    int height = 0;
+};
+
+// Set of (cell, direction) states packed into a bitset.
+// Each 64-bit word carries the epoch it was last written in, so clearing
+// the whole set is just an epoch bump and only touched words are ever reset.
+class GuardStateSet
+{
+public:
+    explicit GuardStateSet(int numCells)
+        : bits(words(numCells), 0)
+        , wordEpochs(words(numCells), 0)
+    {}
+
+    // returns false if the state was already in the set
+    bool insert(int cell, Orientation orientation)
+    {
+        const size_t state = static_cast<size_t>(cell) * 4 + static_cast<int>(orientation);
+        const size_t word = state / 64;
+        const uint64_t mask = uint64_t(1) << (state % 64);
+
+        if (wordEpochs[word] != epoch)
+        {
+            wordEpochs[word] = epoch;
+            bits[word] = 0;
+        }
+
+        const bool isNew = (bits[word] & mask) == 0;
+        bits[word] |= mask;
+        return isNew;
+    }
+
+    void clear()
+    {
+        if (++epoch == 0)
+        {
+            std::fill(wordEpochs.begin(), wordEpochs.end(), 0);
+            epoch = 1;
+        }
+    }
+
+private:
+    static size_t words(int numCells)
+    {
+        return (static_cast<size_t>(numCells) * 4 + 63) / 64;
+    }
+
+    std::vector<uint64_t> bits;
+    std::vector<uint32_t> wordEpochs;
+    uint32_t epoch = 1;
+};
+
 class Solution
 {
 public:
@@ -180,39 +370,53 @@ public:
     {
         board.loadFromFile(path);
         guard = board.getInitialGuardPosition();
+        jumps.build(board);
     }
 
     int part1()
     {
-        while(!isGuardFinished())
-        {
-            moveGuard();
-        }
+        walkGuardOffBoard();
         return board.getNumberOfVisitedTiles();
     }
 
     int part2()
     {
-        int sum = 0;
+        // an obstruction can only change the outcome if it lies on the original route
+        walkGuardOffBoard();
 
-        for (int y = 0; y < board.height(); y++)
-        {
-            for (int x = 0; x < board.width(); x++)
-            {
-                if (Position{x, y} == board.getInitialGuardPosition())
-                    continue;
+        const Position start = board.getInitialGuardPosition();
+        std::vector<Position> candidates = board.getVisitedPositions();
+        candidates.erase(std::remove(candidates.begin(), candidates.end(), start), candidates.end());
+
+        const int numCells = board.width() * board.height();
+        const int numThreads = std::max(1u, std::thread::hardware_concurrency());
 
-                if (board.at({x, y}) == Board::Tile::OBSTRUCTION)
-                    continue;
+        std::atomic<size_t> nextCandidate = 0;
+        std::atomic<int> sum = 0;
 
-                guard = Guard(board.getInitialGuardPosition()); 
-                board.setTileAt({x, y}, Board::Tile::OBSTRUCTION);
-                sum += doesGuardGetStuck();
-                board.setTileAt({x, y}, Board::Tile::EMPTY);
+        auto worker = [&]() {
+            int localSum = 0;
+            GuardStateSet seenStates(numCells);
+            for (size_t i = nextCandidate++; i < candidates.size(); i = nextCandidate++)
+            {
+                seenStates.clear();
+                localSum += doesGuardGetStuck(Guard(start), candidates[i], seenStates);
             }
+            sum += localSum;
+        };
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++)
+        {
+            threads.emplace_back(worker);
         }
 
-        return sum;
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        return sum.load();
     }
 
 private:
@@ -238,23 +442,35 @@ private:
         }
     }
 
-    bool doesGuardGetStuck()
+    void walkGuardOffBoard()
     {
-        int area = board.width() * board.height();
-
-        while (area--)
+        while (!isGuardFinished())
         {
-            if (isGuardFinished())
-                return false;
-            
             moveGuard();
         }
+    }
 
-        return true;
+    // the guard is stuck as soon as it turns at the same cell in the same direction twice
+    bool doesGuardGetStuck(Guard guard, Position obstruction, GuardStateSet& seenStates) const
+    {
+        while (true)
+        {
+            const int stop = jumps.stopFrom(guard.getPosition(), guard.getOrientation(), obstruction);
+
+            if (stop == JumpTable::EXIT)
+                return false;
+
+            if (!seenStates.insert(stop, guard.getOrientation()))
+                return true;
+
+            guard.teleportTo(jumps.positionOf(stop));
+            guard.rotateClockwise();
+        }
     }
 
     Guard guard;
     Board board;
+    JumpTable jumps;
 };
 
 int main()
@@ -3,132 +3,202 @@
 #include <sstream>
 #include <vector>
 #include <string>
-#include <cassert>
+#include <optional>
+#include <algorithm>
+#include <numeric>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+// All intermediate values are 128 bits wide, so even concatenating two
+// 20-digit numbers or multiplying two 64-bit operands cannot overflow.
+using value_t = unsigned __int128;
+
+// Operators are plugged into the solver at compile time. Each one knows how
+// to undo itself: given the value of `lhs <op> operand`, it returns the value
+// `lhs` must have had, nothing if no such value exists, or ANY_VALUE if every
+// `lhs` works.
+static constexpr value_t ANY_VALUE = ~value_t(0);
+
+struct Add
+{
+    static std::optional<value_t> undo(value_t target, value_t operand)
+    {
+        if (target < operand)
+            return {};
+
+        return target - operand;
+    }
+};
+
+struct Multiply
+{
+    static std::optional<value_t> undo(value_t target, value_t operand)
+    {
+        if (operand == 0)
+            return target == 0 ? std::optional<value_t>(ANY_VALUE) : std::nullopt;
+
+        if (target % operand != 0)
+            return {};
+
+        return target / operand;
+    }
+};
+
+struct Concatenate
+{
+    static std::optional<value_t> undo(value_t target, value_t operand)
+    {
+        const value_t power = powerOf10(numDigits(operand));
+
+        if (target % power != operand)
+            return {};
+
+        return target / power;
+    }
+
+    static int numDigits(value_t n)
+    {
+        int count = 1;
+        while (n >= 10)
+        {
+            n /= 10;
+            count++;
+        }
+        return count;
+    }
+
+    static value_t powerOf10(int n)
+    {
+        value_t result = 1;
+        for (int i = 0; i < n; i++)
+            result *= 10;
+        return result;
+    }
+};
 
 struct Equation
 {
     size_t result;
     std::vector<size_t> operands;
 
-    bool canBeValidForTwoOperators() const
+    template <typename... Operators>
+    bool canBeValidFor() const
     {
-        const int numOperators = operands.size() - 1;
+        return canReachFromBack<Operators...>(operands.size() - 1, result);
+    }
 
-        using bitmask_t = size_t;
-        assert(numOperators <= sizeof(bitmask_t) * 8);
+    // Same as canBeValidFor(), but only explores the branch where the last
+    // operator is the one at `operatorIdx` in the Operators pack.
+    // Lets one expensive equation be split into independent pieces of work.
+    template <typename... Operators>
+    bool canBeValidWithLastOperator(size_t operatorIdx) const
+    {
+        const size_t last = operands.size() - 1;
 
-        const int maxBitmasksNeeded = 1 << numOperators;
-        for (bitmask_t bitmask = 0; bitmask < maxBitmasksNeeded; bitmask++)
-        {
-            size_t total = operands[0];
+        if (last == 0)
+            return result == operands[0];
 
-            for (int i = 0; i < operands.size() - 1; i++)
-            {
-                const bool isAddition = (bitmask >> i) & 1;
-                const int otherOperand = operands[i+1];
-                if (isAddition)
-                    total += otherOperand;
-                else
-                    total *= otherOperand;
-            }
+        size_t idx = 0;
+        return ((idx++ == operatorIdx && continueFrom<Operators...>(last, Operators::undo(result, operands[last]))) || ...);
+    }
 
-            if (total == result)
-                return true;
-        }
+private:
+    // Works backwards from the result: the last operand must have been
+    // combined using one of the operators, so undo each of those that is
+    // possible and recurse on the remaining operands. The undone value never
+    // grows past the result, and most branches die immediately because the
+    // subtraction underflows, the division is inexact or the digits do not match.
+    template <typename... Operators>
+    bool canReachFromBack(size_t i, value_t target) const
+    {
+        if (i == 0)
+            return target == operands[0];
 
-        return false;
-    };
+        return (continueFrom<Operators...>(i, Operators::undo(target, operands[i])) || ...);
+    }
 
+    // continues the search after the operator before operand `i` has been undone
+    template <typename... Operators>
+    bool continueFrom(size_t i, std::optional<value_t> lhs) const
+    {
+        return lhs.has_value() && (lhs == ANY_VALUE || canReachFromBack<Operators...>(i - 1, *lhs));
+    }
+};
 
-    bool canBeValidForThreeOperators() const
+// Runs a fixed batch of tasks on all cores. Every worker owns a queue
+// and takes work from its back; once the queue is empty, it steals from
+// the front of the other workers' queues.
+class WorkStealingPool
+{
+public:
+    // calls `task(i)` once for every i in [0, numTasks)
+    template <typename Task>
+    static void run(size_t numTasks, Task const& task)
     {
-        if (canBeValidForTwoOperators())
-            return true;
+        const size_t numWorkers = std::max(1u, std::thread::hardware_concurrency());
 
-        enum class Operator
+        std::vector<Queue> queues(numWorkers);
+        for (size_t i = 0; i < numTasks; i++)
         {
-            ADD = 0b00,
-            MULTIPLY = 0b01,
-            CONCATENATE = 0b10,
-            INVALID = 0b11
-        };
-
-        const int numOperators = operands.size() - 1;
+            queues[i % numWorkers].tasks.push_back(i);
+        }
 
-        using bitmask_t = size_t;
-        constexpr int BITS_PER_OPERATOR = 2;
-        assert(numOperators <= sizeof(bitmask_t) * 8 / BITS_PER_OPERATOR);
+        auto worker = [&](size_t self) {
+            while (true)
+            {
+                std::optional<size_t> next = queues[self].popBack();
 
-        auto ithOperator = [] (bitmask_t bitmask, int i) -> Operator {
-            return static_cast<Operator>((bitmask >> (i * BITS_PER_OPERATOR)) & 0b11);
-        };
+                for (size_t k = 1; !next.has_value() && k < numWorkers; k++)
+                    next = queues[(self + k) % numWorkers].popFront();
 
-        auto validateBitmask = [numOperators, ithOperator] (bitmask_t bitmask) -> bool {
-            bool hasConcat = false;
-            for (int i = 0; i < numOperators; i++)
-            {
-                Operator op = ithOperator(bitmask, i);
+                // no task ever spawns new ones, so empty queues stay empty
+                if (!next.has_value())
+                    return;
 
-                if (op == Operator::CONCATENATE)
-                    hasConcat = true;
-                else if (op == Operator::INVALID)
-                    return false;
+                task(*next);
             }
-            return hasConcat;
         };
 
-        const int numBitmasks = 1 << (numOperators * BITS_PER_OPERATOR);
-        for (bitmask_t bitmask = 0; bitmask < numBitmasks; bitmask++)
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numWorkers; t++)
         {
-            if (!validateBitmask(bitmask))
-                continue;
-
-            size_t total = operands[0];
-
-            for (int i = 0; i < numOperators; i++)
-            {
-                const Operator op = ithOperator(bitmask, i);
-                const int otherOperand = operands[i+1];
-                
-                switch (op)
-                {
-                case Operator::ADD:
-                    total += otherOperand;
-                    break;
-                case Operator::MULTIPLY:
-                    total *= otherOperand;
-                    break;
-                case Operator::CONCATENATE:
-                    total = total * powerOf10(numDigits(otherOperand)) + otherOperand;
-                    break;
-                }
-            }
-
-            if (total == result)
-                return true;
+            threads.emplace_back(worker, t);
         }
 
-        return false;
-    };
-
-    int numDigits(size_t n) const
-    {
-        int count = 0;
-        while (n != 0)
+        for (auto& thread : threads)
         {
-            n /= 10;
-            count++;
+            thread.join();
         }
-        return count;
     }
 
-    size_t powerOf10(int n) const
+private:
+    struct Queue
     {
-        size_t result = 1;
-        for (int i = 0; i < n; i++)
-            result *= 10;
-        return result;
-    }
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+
+        std::optional<size_t> popBack()
+        {
+            std::lock_guard lock(mutex);
+            if (tasks.empty())
+                return {};
+            const size_t task = tasks.back();
+            tasks.pop_back();
+            return task;
+        }
+
+        std::optional<size_t> popFront()
+        {
+            std::lock_guard lock(mutex);
+            if (tasks.empty())
+                return {};
+            const size_t task = tasks.front();
+            tasks.pop_front();
+            return task;
+        }
+    };
 };
 
 class Solution
@@ -149,26 +219,39 @@ public:
         {
             parseLineAsEquation(line);
         }
+
+        // part 2 only has to search the equations that fail with two operators
+        validForTwoOperators = findValidEquations<Multiply, Add>(allEquations());
     }
 
     size_t part1() const
     {
         size_t sum = 0;
-        for (Equation const& eq : equations)
+        for (size_t i = 0; i < equations.size(); i++)
         {
-            if (eq.canBeValidForTwoOperators())
-                sum += eq.result;
+            if (validForTwoOperators[i])
+                sum += equations[i].result;
         }
         return sum;
     }
-    
+
     size_t part2() const
     {
+        // anything valid with two operators stays valid with three
+        std::vector<size_t> remaining;
+        for (size_t i = 0; i < equations.size(); i++)
+        {
+            if (!validForTwoOperators[i])
+                remaining.push_back(i);
+        }
+
+        const std::vector<char> validForThreeOperators = findValidEquations<Concatenate, Multiply, Add>(remaining);
+
         size_t sum = 0;
-        for (Equation const& eq : equations)
+        for (size_t i = 0; i < equations.size(); i++)
         {
-            if (eq.canBeValidForThreeOperators())
-                sum += eq.result;
+            if (validForTwoOperators[i] || validForThreeOperators[i])
+                sum += equations[i].result;
         }
         return sum;
     }
@@ -182,7 +265,7 @@ private:
         std::istringstream iss(line);
         iss >> equation.result >> colon;
 
-        int operand;
+        size_t operand;
         while (iss >> operand)
         {
             equation.operands.push_back(operand);
@@ -191,7 +274,70 @@ private:
         equations.emplace_back(std::move(equation));
     }
 
+    std::vector<size_t> allEquations() const
+    {
+        std::vector<size_t> indices(equations.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        return indices;
+    }
+
+    // Checks the given equations in parallel and returns a verdict for every
+    // equation (those not checked are reported as invalid). The cost of an
+    // equation grows exponentially with its length, so long ones are split
+    // into one task per choice of their last operator.
+    template <typename... Operators>
+    std::vector<char> findValidEquations(std::vector<size_t> const& indices) const
+    {
+        constexpr size_t MIN_OPERANDS_TO_SPLIT = 8;
+        constexpr size_t WHOLE_EQUATION = -1;
+
+        struct Task
+        {
+            size_t equation;
+            size_t lastOperator;
+        };
+
+        std::vector<Task> tasks;
+        for (size_t idx : indices)
+        {
+            if (equations[idx].operands.size() < MIN_OPERANDS_TO_SPLIT)
+            {
+                tasks.push_back({ idx, WHOLE_EQUATION });
+                continue;
+            }
+
+            for (size_t op = 0; op < sizeof...(Operators); op++)
+                tasks.push_back({ idx, op });
+        }
+
+        // workers take from the back of their queues, so the longest equations go first
+        std::stable_sort(tasks.begin(), tasks.end(), [this] (Task const& a, Task const& b) {
+            return equations[a.equation].operands.size() < equations[b.equation].operands.size();
+        });
+
+        std::vector<std::atomic<bool>> isValid(equations.size());
+
+        WorkStealingPool::run(tasks.size(), [&] (size_t t) {
+            Task const& task = tasks[t];
+            Equation const& eq = equations[task.equation];
+
+            // another branch of the same equation already succeeded
+            if (isValid[task.equation])
+                return;
+
+            const bool valid = task.lastOperator == WHOLE_EQUATION
+                ? eq.canBeValidFor<Operators...>()
+                : eq.canBeValidWithLastOperator<Operators...>(task.lastOperator);
+
+            if (valid)
+                isValid[task.equation] = true;
+        });
+
+        return std::vector<char>(isValid.begin(), isValid.end());
+    }
+
     std::vector<Equation> equations;
+    std::vector<char> validForTwoOperators;
 };
 
 int main()
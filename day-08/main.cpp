@@ -2,7 +2,12 @@
 #include <fstream>
 #include <vector>
 #include <unordered_map>
-#include <unordered_set>
+#include <numeric>
+#include <bit>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 
 struct Position
 {
@@ -15,18 +20,6 @@ struct Position
     }
 };
 
-namespace std
-{
-    template <>
-    struct hash<Position>
-    {
-        size_t operator()(Position const& p) const
-        {
-            return ((size_t)p.x << 32) | (size_t)p.y;
-        }
-    };
-}
-
 struct Map
 {
     std::unordered_map<char, std::vector<Position>> antennaPositions;
@@ -67,6 +60,46 @@ struct Map
 };
 
 
+// One bit per map cell, so marking an antinode is a single OR
+// and duplicates cost nothing.
+class AntinodeBitmap
+{
+public:
+    AntinodeBitmap(int width, int height)
+        : width(width)
+        , bits((static_cast<size_t>(width) * height + 63) / 64, 0)
+    {}
+
+    void mark(Position p)
+    {
+        const size_t idx = static_cast<size_t>(p.y) * width + p.x;
+        bits[idx / 64] |= uint64_t(1) << (idx % 64);
+    }
+
+    int count(size_t beginWord = 0, size_t endWord = -1) const
+    {
+        int sum = 0;
+        for (size_t w = beginWord; w < std::min(endWord, bits.size()); w++)
+            sum += std::popcount(bits[w]);
+        return sum;
+    }
+
+    void merge(AntinodeBitmap const& other, size_t beginWord, size_t endWord)
+    {
+        for (size_t w = beginWord; w < std::min(endWord, bits.size()); w++)
+            bits[w] |= other.bits[w];
+    }
+
+    size_t numWords() const
+    {
+        return bits.size();
+    }
+
+private:
+    int width;
+    std::vector<uint64_t> bits;
+};
+
 class Solution
 {
 public:
@@ -88,74 +121,113 @@ public:
 private:
     int countUniqueAntinodes() const
     {
-        std::unordered_set<Position> antinodePositions;
+        return countAntinodes([this] (Position first, Position second, AntinodeBitmap& antinodes) {
+            const int run  = second.x - first.x;
+            const int rise = second.y - first.y;
 
-        for (auto const& [c, antennas] : map.antennaPositions)
-        {
-            for (int i = 0; i < antennas.size() - 1; i++)
-            {
-                for (int j = i + 1; j < antennas.size(); j++)
-                {
-                    const Position first = antennas[i];
-                    const Position second = antennas[j];
-
-                    const int run  = second.x - first.x;
-                    const int rise = second.y - first.y;
-
-                    const Position antinodeA = {second.x + run, second.y + rise};
-                    const Position antinodeB = {first.x - run,  first.y - rise};
-
-                    if (map.isValidPosition(antinodeA))
-                        antinodePositions.insert(antinodeA);
-                    
-                    if (map.isValidPosition(antinodeB))
-                        antinodePositions.insert(antinodeB);
-                }
-            }
-        }
+            const Position antinodeA = {second.x + run, second.y + rise};
+            const Position antinodeB = {first.x - run,  first.y - rise};
 
-        return antinodePositions.size();
+            if (map.isValidPosition(antinodeA))
+                antinodes.mark(antinodeA);
+
+            if (map.isValidPosition(antinodeB))
+                antinodes.mark(antinodeB);
+        });
     }
 
 
     int countUniqueAntinodesPart2() const
     {
-        std::unordered_set<Position> antinodePositions;
+        return countAntinodes([this] (Position origin, Position reference, AntinodeBitmap& antinodes) {
+            // reduce the step so grid points between the antennas are hit too
+            const int divisor = std::gcd(reference.x - origin.x, reference.y - origin.y);
+            const int run  = (reference.x - origin.x) / divisor;
+            const int rise = (reference.y - origin.y) / divisor;
+
+            Position tested = origin;
+            while (map.isValidPosition(tested))
+            {
+                antinodes.mark(tested);
+                tested.x += run;
+                tested.y += rise;
+            }
 
+            tested = {origin.x - run, origin.y - rise};
+            while (map.isValidPosition(tested))
+            {
+                antinodes.mark(tested);
+                tested.x -= run;
+                tested.y -= rise;
+            }
+        });
+    }
+
+    // Calls `markPair` for every pair of antennas of the same frequency.
+    // Pairs are handed out to worker threads one antenna at a time (pairing it
+    // with every later antenna of its frequency), so frequencies with thousands
+    // of antennas are shared between workers too. Every worker marks into its
+    // own bitmap; the bitmaps are then OR-merged and counted, each worker
+    // handling one slice of the words.
+    template <typename MarkPair>
+    int countAntinodes(MarkPair const& markPair) const
+    {
+        struct Task
+        {
+            std::vector<Position> const* antennas;
+            size_t first;
+        };
+
+        std::vector<Task> tasks;
         for (auto const& [c, antennas] : map.antennaPositions)
         {
-            for (int i = 0; i < antennas.size() - 1; i++)
+            for (size_t i = 0; i + 1 < antennas.size(); i++)
+                tasks.push_back({ &antennas, i });
+        }
+
+        const int numThreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<AntinodeBitmap> bitmaps(numThreads, AntinodeBitmap(map.width, map.height));
+
+        std::atomic<size_t> nextTask = 0;
+        runOnAllThreads(numThreads, [&] (int t) {
+            for (size_t k = nextTask++; k < tasks.size(); k = nextTask++)
             {
-                for (int j = i + 1; j < antennas.size(); j++)
-                {
-                    const Position origin = antennas[i];
-                    const Position reference = antennas[j];
-
-                    antinodePositions.insert(origin);
-
-                    const int run  = reference.x - origin.x;
-                    const int rise = reference.y - origin.y;
-
-                    Position tested = reference;
-                    while (map.isValidPosition(tested))
-                    {
-                        antinodePositions.insert(tested);
-                        tested.x += run;
-                        tested.y += rise;
-                    }
-
-                    tested = origin;
-                    while (map.isValidPosition(tested))
-                    {
-                        antinodePositions.insert(tested);
-                        tested.x -= run;
-                        tested.y -= rise;
-                    }
-                }
+                std::vector<Position> const& antennas = *tasks[k].antennas;
+                const size_t i = tasks[k].first;
+
+                for (size_t j = i + 1; j < antennas.size(); j++)
+                    markPair(antennas[i], antennas[j], bitmaps[t]);
             }
+        });
+
+        const size_t numWords = bitmaps[0].numWords();
+        std::atomic<int> total = 0;
+        runOnAllThreads(numThreads, [&] (int t) {
+            const size_t begin = numWords * t / numThreads;
+            const size_t end = numWords * (t + 1) / numThreads;
+
+            for (int other = 1; other < numThreads; other++)
+                bitmaps[0].merge(bitmaps[other], begin, end);
+
+            total += bitmaps[0].count(begin, end);
+        });
+
+        return total.load();
+    }
+
+    template <typename Work>
+    static void runOnAllThreads(int numThreads, Work const& work)
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++)
+        {
+            threads.emplace_back(work, t);
         }
 
-        return antinodePositions.size();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
     }
 
     Map map;
@@ -2,19 +2,36 @@
 #include <fstream>
 #include <vector>
 #include <string>
-#include <cassert>
+#include <algorithm>
+#include <queue>
+#include <functional>
 
 
+// The disk is kept as runs of blocks rather than one slot per block,
+// so memory grows with the number of files and gaps, not with the disk size.
 class DiskImage
 {
 public:
     using id_t = size_t;
-    static constexpr id_t EMPTY_ID = -1;
+
+    struct Run
+    {
+        size_t start = 0;
+        size_t length = 0;
+        id_t id = 0; // unused for free space
+
+        // sum of (position * id) over the blocks of the run, in closed form
+        size_t getChecksum() const
+        {
+            return id * (length * start + length * (length - 1) / 2);
+        }
+    };
 
     void loadFromFile(std::string const& path)
     {
         std::ifstream file(path);
-        disk.clear();
+        files.clear();
+        freeSpans.clear();
 
         if (!file)
         {
@@ -22,159 +39,202 @@ public:
             return;
         }
 
-        id_t currID = 0;
+        size_t position = 0;
         bool isFile = true;
 
         char c;
         while (file >> c)
         {
-            const int numFileFragments = c - '0';
-
-            for (int i = 0; i < numFileFragments; i++)
-                disk.push_back(isFile ? currID : EMPTY_ID);
+            const size_t length = c - '0';
 
             if (isFile)
-                currID++;
+                files.push_back({ position, length, files.size() });
+            else if (length > 0)
+            {
+                // an empty file between two gaps leaves them touching, so they form one span
+                if (!freeSpans.empty() && freeSpans.back().start + freeSpans.back().length == position)
+                    freeSpans.back().length += length;
+                else
+                    freeSpans.push_back({ position, length });
+            }
 
+            position += length;
             isFile = !isFile;
         }
     }
 
-    void defragment()
+    // Checksum of the disk after moving single blocks from the end into the
+    // leftmost gaps. Walks the gaps from the front and the files from the back
+    // at the same time and sums the moved fragments as they are placed,
+    // so the image itself is never modified.
+    size_t getChecksumAfterDefragment() const
     {
-        size_t emptyIdx = findFirstEmptySpace();
-        if (emptyIdx == -1)
-            return;
-
-        for (int i = disk.size() - 1; i >= 0; i--)
-        {
-            if (i <= emptyIdx)
-                return;
-
-            std::swap(disk[i], disk[emptyIdx]);
-
-            while (disk[emptyIdx] != EMPTY_ID)
-                emptyIdx++;
-        }
-    }
+        size_t sum = 0;
 
-    void defragmentWithoutSplittingFiles()
-    {
-        id_t minFileID = -1;
+        size_t gapIdx = 0;
+        size_t gapStart = 0;
+        size_t gapLeft = 0;
 
-        assert(minFileID > 0); // make sure id is unsigned and overflowed to max
+        auto loadGap = [&] {
+            if (gapIdx < freeSpans.size())
+            {
+                gapStart = freeSpans[gapIdx].start;
+                gapLeft = freeSpans[gapIdx].length;
+            }
+        };
+        loadGap();
 
-        for (int i = disk.size() - 1; i >= 0;)
+        for (size_t i = files.size(); i-- > 0;)
         {
-            auto const [fileID, fileStart, fileSize] = findFirstFileAtOrBeforePos(i);
+            Run const& file = files[i];
+            size_t fileLeft = file.length;
 
-            if (fileID < minFileID)
+            while (fileLeft > 0 && gapIdx < freeSpans.size() && gapStart < file.start)
             {
-                minFileID = fileID;
-                const int emptyIdx = findFirstEmptySpace(fileSize);
+                const size_t numBlocks = std::min(gapLeft, fileLeft);
+
+                sum += Run{ gapStart, numBlocks, file.id }.getChecksum();
+                gapStart += numBlocks;
+                gapLeft -= numBlocks;
+                fileLeft -= numBlocks;
+
+                if (gapLeft == 0)
+                {
+                    gapIdx++;
+                    loadGap();
+                }
+            }
 
-                if (emptyIdx != -1 && emptyIdx < fileStart)
-                    for (int j = 0; j < fileSize; j++)
-                        std::swap(disk[fileStart + j], disk[emptyIdx + j]);
+            // no gap left before this file, so it and every file before it stay where they are
+            if (fileLeft > 0)
+            {
+                sum += Run{ file.start, fileLeft, file.id }.getChecksum();
+                for (size_t j = 0; j < i; j++)
+                    sum += files[j].getChecksum();
+                break;
             }
-            
-            i = fileStart - 1;
         }
+
+        return sum;
     }
 
-    size_t getChecksum() const
+    // Checksum of the disk after moving whole files, from the last one,
+    // into the leftmost gap that fits them. Like above, the image is not modified.
+    size_t getChecksumAfterDefragmentWithoutSplittingFiles() const
     {
+        FreeSpaceIndex index(freeSpans);
         size_t sum = 0;
-        size_t slot = 0;
-        for (size_t i = 0; i < disk.size(); i++)
+
+        for (size_t i = files.size(); i-- > 0;)
         {
-            size_t num = disk[i];
+            Run file = files[i];
+            const size_t newStart = index.allocateLeftmost(file.length, file.start);
+
+            if (newStart != FreeSpaceIndex::NONE)
+                file.start = newStart;
 
-            if (num != EMPTY_ID)
-                sum += slot * num;
-            
-            slot++;
+            sum += file.getChecksum();
         }
+
         return sum;
     }
 
 private:
-    int findFirstEmptySpace(int minSize = 1)
+    // Gaps are bucketed by length, with one min-heap of start offsets per length.
+    // Files are at most 9 blocks long, so every gap of 9 or more blocks fits any
+    // of them and shares the last bucket, with its real length kept in the entry.
+    // Finding the leftmost gap that fits a file means comparing at most 9 heap tops.
+    class FreeSpaceIndex
     {
-        for (int i = 0; i <= disk.size() - minSize; i++)
+    public:
+        static constexpr size_t NONE = -1;
+
+        explicit FreeSpaceIndex(std::vector<Run> const& spans)
         {
-            if (disk[i] != EMPTY_ID)
-                continue;
+            for (Run const& span : spans)
+                addGap(span.start, span.length);
+        }
 
-            for (int j = 0; j < minSize; j++)
+        // Takes `length` blocks from the leftmost gap that fits them and starts before `limit`.
+        // Returns where the blocks were taken from, or NONE if there is no such gap.
+        size_t allocateLeftmost(size_t length, size_t limit)
+        {
+            size_t bestBucket = 0;
+            Gap best = { limit, 0 };
+
+            for (size_t l = std::max<size_t>(length, 1); l <= MAX_GAP_LENGTH; l++)
             {
-                if (disk[i+j] != EMPTY_ID)
-                    break;
+                if (!gapsOfLength[l].empty() && gapsOfLength[l].top().start < best.start)
+                {
+                    best = gapsOfLength[l].top();
+                    bestBucket = l;
+                }
+            }
+
+            if (bestBucket == 0)
+                return NONE;
+
+            gapsOfLength[bestBucket].pop();
+            addGap(best.start + length, best.length - length);
 
-                if (j == minSize - 1)
-                    return i;
+            return best.start;
+        }
+
+    private:
+        static constexpr size_t MAX_GAP_LENGTH = 9;
+
+        struct Gap
+        {
+            size_t start = 0;
+            size_t length = 0;
+
+            bool operator>(Gap const& other) const
+            {
+                return start > other.start;
             }
+        };
+
+        void addGap(size_t start, size_t length)
+        {
+            if (length > 0)
+                gapsOfLength[std::min(length, MAX_GAP_LENGTH)].push({ start, length });
         }
-        return -1;
-    }
 
-    std::tuple<id_t, int, int> findFirstFileAtOrBeforePos(int pos)
-    {
-        // this algorithm assumes there IS a file at or before the given position
-        // for the input format this task uses, this will always be the case
-        // because the disk always starts with a file
-
-        while (disk[pos] == EMPTY_ID)
-            pos--;
-        
-        const int fileEnd = pos;
-        const id_t fileID = disk[pos];
-
-        while (pos >= 0 && disk[pos] == fileID)
-            pos--;
-        
-        const int fileStart = pos + 1;
-        const int fileSize = fileEnd - fileStart + 1;
-
-        return { fileID, fileStart, fileSize };
-    }
+        using MinHeap = std::priority_queue<Gap, std::vector<Gap>, std::greater<Gap>>;
+        MinHeap gapsOfLength[MAX_GAP_LENGTH + 1];
+    };
 
-    std::vector<id_t> disk;
+    std::vector<Run> files;
+    std::vector<Run> freeSpans;
 };
 
 
 class Solution
 {
 public:
-    void setInputFilePath(std::string const& path)
+    void loadInputFromFile(std::string const& path)
     {
-        inputPath = path;
+        image.loadFromFile(path);
     }
 
     size_t part1() const
     {
-        DiskImage image;
-        image.loadFromFile(inputPath);
-        image.defragment();
-        return image.getChecksum();
+        return image.getChecksumAfterDefragment();
     }
 
     size_t part2() const
     {
-        DiskImage image;
-        image.loadFromFile(inputPath);
-        image.defragmentWithoutSplittingFiles();
-        return image.getChecksum();
+        return image.getChecksumAfterDefragmentWithoutSplittingFiles();
     }
 
 private:
-    std::string inputPath;
+    DiskImage image;
 };
 
 int main()
 {
     Solution solution;
-    solution.setInputFilePath("../input.txt");
+    solution.loadInputFromFile("../input.txt");
 
     std::cout << solution.part1() << std::endl;
     std::cout << solution.part2() << std::endl;
@@ -2,26 +2,19 @@
 #include <fstream>
 #include <vector>
 #include <string>
-#include <unordered_set>
+#include <bit>
+#include <cstdint>
 #include <array>
 
-namespace std
-{
-    template<>
-    struct hash<std::pair<int, int>>
-    {
-        size_t operator()(std::pair<int,int> const& p) const
-        {
-            return std::hash<int>{}(p.first) << 16 | std::hash<int>{}(p.second);
-        }
-    };
-}
-
+// Heights are stored one byte per cell, row by row, with a border of
+// NO_HEIGHT cells around the map. Every neighbour of a map cell is then
+// a valid index, and a neighbour test is a plain byte comparison.
 class Heightmap
 {
 public:
-    static constexpr int TRAIL_START = 0;
-    static constexpr int TRAIL_END   = 9;
+    static constexpr uint8_t TRAIL_START = 0;
+    static constexpr uint8_t TRAIL_END   = 9;
+    static constexpr uint8_t NO_HEIGHT   = 0xFF;
 
     void loadFromFile(const char* path)
     {
@@ -33,24 +26,42 @@ public:
             return;
         }
 
+        std::vector<std::string> lines;
         std::string line;
         while (std::getline(file, line))
         {
-            height++;
-            width = line.length();
-            for (char c : line)
+            lines.push_back(line);
+        }
+
+        height = lines.size();
+        width = lines.empty() ? 0 : lines[0].length();
+        stride = width + 2;
+        map.assign(stride * (height + 2), NO_HEIGHT);
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
             {
-                map.push_back(c - '0');
+                const char c = lines[y][x];
+                if (c >= '0' && c <= '9')
+                    map[index(x, y)] = c - '0';
             }
         }
     }
 
-    int at(int x, int y) const
+    size_t index(int x, int y) const
+    {
+        return (y + 1) * stride + (x + 1);
+    }
+
+    uint8_t const* data() const
     {
-        if (x < 0 || x >= width || y < 0 || y >= height)
-            return -1;
-        
-        return map[y * width + x];
+        return map.data();
+    }
+
+    size_t size() const
+    {
+        return map.size();
     }
 
     int getWidth() const
@@ -63,10 +74,16 @@ public:
         return height;
     }
 
+    int getStride() const
+    {
+        return stride;
+    }
+
 private:
-    std::vector<int> map;
+    std::vector<uint8_t> map;
     int width = 0;
     int height = 0;
+    int stride = 0;
 };
 
 
@@ -76,67 +93,161 @@ public:
     void loadInputFromFile(const char* path)
     {
         heightmap.loadFromFile(path);
+        totalScore = computeTotalScore();
+        totalRating = computeTotalRating();
     }
 
     size_t part1() const
     {
-        uniqueTrailsEnds = true;
-        return partCommon();
+        return totalScore;
     }
 
     size_t part2() const
     {
-        uniqueTrailsEnds = false;
-        return partCommon();
+        return totalRating;
     }
 
 private:
-    size_t partCommon() const
+    // The rating of a cell is the number of distinct trails from it to a trail end,
+    // i.e. the sum of the ratings of its neighbours one level higher.
+    // Each level is one branch-free pass over whole rows, which GCC vectorises
+    // at -O3 (the default Release build), so the sweep is bound by memory bandwidth.
+    // Odd and even levels live in separate buffers so a pass never reads what it writes.
+    size_t computeTotalRating() const
     {
-        size_t sum = 0;
-        for (int y = 0; y < heightmap.getHeight(); y++)
+        const uint8_t* heights = heightmap.data();
+        std::array<std::vector<uint32_t>, 2> ratings;
+        ratings[0].assign(heightmap.size(), 0);
+        ratings[1].assign(heightmap.size(), 0);
+
+        for (int level = Heightmap::TRAIL_END; level >= Heightmap::TRAIL_START; level--)
         {
-            for (int x = 0; x < heightmap.getWidth(); x++)
+            uint32_t const* __restrict higher = ratings[(level + 1) % 2].data();
+            uint32_t* __restrict current = ratings[level % 2].data();
+
+            if (level == Heightmap::TRAIL_END)
+            {
+                forEachRow([&] (size_t begin, size_t end) {
+                    for (size_t c = begin; c < end; c++)
+                        current[c] = heights[c] == level;
+                });
+            }
+            else
             {
-                visitedTrailEnds.clear();
-                size_t score = countTrailEndsReachableFrom(x, y);
-                sum += score;
+                propagateRatings(heights, level, higher, current);
             }
         }
-        return sum;
+
+        size_t total = 0;
+        uint32_t const* trailheadRatings = ratings[Heightmap::TRAIL_START % 2].data();
+        forEachRow([&] (size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++)
+                total += trailheadRatings[c];
+        });
+        return total;
     }
 
-    size_t countTrailEndsReachableFrom(int x, int y, int height = Heightmap::TRAIL_START) const
+    void propagateRatings(uint8_t const* __restrict heights, uint8_t level, uint32_t const* __restrict higher, uint32_t* __restrict current) const
     {
-        if (heightmap.at(x, y) != height)
-        {
+        const size_t stride = heightmap.getStride();
+        const uint8_t up = level + 1;
+
+        forEachRow([&] (size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++)
+            {
+                // multiplying by the comparison keeps the loop free of branches
+                const uint32_t sum = (heights[c - 1]      == up) * higher[c - 1]
+                                   + (heights[c + 1]      == up) * higher[c + 1]
+                                   + (heights[c - stride] == up) * higher[c - stride]
+                                   + (heights[c + stride] == up) * higher[c + stride];
+
+                current[c] = (heights[c] == level) * sum;
+            }
+        });
+    }
+
+    // The score of a trailhead is the number of distinct trail ends it reaches.
+    // Sweeps the map one height at a time, from the trail ends down, giving every
+    // cell a bitset of reachable trail ends: the union of its higher neighbours' bitsets.
+    // Only two levels of bitsets are alive at once.
+    size_t computeTotalScore() const
+    {
+        const uint8_t* heights = heightmap.data();
+        const int stride = heightmap.getStride();
+
+        std::array<std::vector<size_t>, Heightmap::TRAIL_END + 1> cellsOfHeight;
+        forEachRow([&] (size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++)
+            {
+                if (heights[c] <= Heightmap::TRAIL_END)
+                    cellsOfHeight[heights[c]].push_back(c);
+            }
+        });
+
+        const size_t numTrailEnds = cellsOfHeight[Heightmap::TRAIL_END].size();
+        if (numTrailEnds == 0)
             return 0;
-        }
 
-        if (height == Heightmap::TRAIL_END && !hasVisitedTrailEndAt(x, y))
+        const size_t wordsPerCell = (numTrailEnds + 63) / 64;
+
+        // index of each cell within its own height level, used to find its bitset
+        std::vector<uint32_t> slotInLevel(heightmap.size(), 0);
+
+        std::vector<uint64_t> higherLevel;
+        std::vector<uint64_t> currentLevel;
+
+        for (int level = Heightmap::TRAIL_END; level >= Heightmap::TRAIL_START; level--)
         {
-            if (uniqueTrailsEnds)
-                visitedTrailEnds.insert({x, y});
-            return 1;
+            std::vector<size_t> const& cells = cellsOfHeight[level];
+            currentLevel.assign(cells.size() * wordsPerCell, 0);
+
+            for (size_t slot = 0; slot < cells.size(); slot++)
+            {
+                const size_t cell = cells[slot];
+                slotInLevel[cell] = slot;
+                uint64_t* reachable = &currentLevel[slot * wordsPerCell];
+
+                if (level == Heightmap::TRAIL_END)
+                {
+                    reachable[slot / 64] |= uint64_t(1) << (slot % 64);
+                    continue;
+                }
+
+                for (const int delta : { 1, -1, stride, -stride })
+                {
+                    const size_t neighbour = cell + delta;
+                    if (heights[neighbour] != level + 1)
+                        continue;
+
+                    uint64_t const* neighbourReachable = &higherLevel[slotInLevel[neighbour] * wordsPerCell];
+                    for (size_t w = 0; w < wordsPerCell; w++)
+                        reachable[w] |= neighbourReachable[w];
+                }
+            }
+
+            std::swap(higherLevel, currentLevel);
         }
-        
-        constexpr std::array<std::pair<int,int>, 4> deltas {{{1,0}, {-1,0}, {0,1}, {0,-1}}};
-        size_t trails = 0;
-
-        for (auto const [dx, dy] : deltas)
-            trails += countTrailEndsReachableFrom(x+dx, y+dy, height+1);
-            
-        return trails;
+
+        size_t total = 0;
+        for (uint64_t word : higherLevel)
+            total += std::popcount(word);
+        return total;
     }
 
-    bool hasVisitedTrailEndAt(int x, int y) const
+    // calls `work(begin, end)` with the index range of the map cells in every row
+    template <typename Work>
+    void forEachRow(Work const& work) const
     {
-        return visitedTrailEnds.count({x, y}) != 0;
+        for (int y = 0; y < heightmap.getHeight(); y++)
+        {
+            const size_t begin = heightmap.index(0, y);
+            work(begin, begin + heightmap.getWidth());
+        }
     }
 
     Heightmap heightmap;
-    mutable std::unordered_set<std::pair<int, int>> visitedTrailEnds;
-    mutable bool uniqueTrailsEnds = false;
+    size_t totalScore = 0;
+    size_t totalRating = 0;
 };
 
 int main()
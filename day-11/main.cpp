@@ -1,124 +1,386 @@
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
-#include <cmath>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <bit>
 
-class Solution
+// Linear recurrence modulo a prime, found from the first terms of a sequence
+// with Berlekamp-Massey. Its n-th term is read off x^n modulo the characteristic
+// polynomial, computed by repeated squaring in O(L^2 log n) for a recurrence of length L.
+class LinearRecurrence
 {
 public:
-    void setInputFilePath(const char* path)
+    static constexpr uint64_t MODULUS = 1'000'000'007;
+
+    // `terms` must hold at least twice as many terms as the length of the recurrence
+    explicit LinearRecurrence(std::vector<uint64_t> const& terms)
+        : initialTerms(terms)
     {
-        inputFilePath = path;
+        std::vector<uint64_t> current = { 1 };
+        std::vector<uint64_t> previous = { 1 };
+        uint64_t previousDiscrepancy = 1;
+        size_t length = 0;
+        size_t shift = 1;
+
+        for (size_t n = 0; n < terms.size(); n++)
+        {
+            uint64_t discrepancy = terms[n];
+            for (size_t i = 1; i <= length; i++)
+                discrepancy = (discrepancy + current[i] * terms[n - i]) % MODULUS;
+
+            if (discrepancy == 0)
+            {
+                shift++;
+                continue;
+            }
+
+            const std::vector<uint64_t> beforeUpdate = current;
+            const uint64_t scale = discrepancy * inverse(previousDiscrepancy) % MODULUS;
+
+            current.resize(std::max(current.size(), previous.size() + shift), 0);
+            for (size_t i = 0; i < previous.size(); i++)
+                current[i + shift] = (current[i + shift] + MODULUS - scale * previous[i] % MODULUS) % MODULUS;
+
+            if (2 * length <= n)
+            {
+                length = n + 1 - length;
+                previous = beforeUpdate;
+                previousDiscrepancy = discrepancy;
+                shift = 1;
+            }
+            else
+            {
+                shift++;
+            }
+        }
+
+        // term[n] = sum of coefficients[i] * term[n - 1 - i]
+        coefficients.resize(length);
+        for (size_t i = 0; i < length; i++)
+            coefficients[i] = (MODULUS - (i + 1 < current.size() ? current[i + 1] : 0)) % MODULUS;
     }
 
-    size_t part1()
+    uint64_t nthTerm(uint64_t n) const
     {
-        return partCommon(25);
+        if (n < initialTerms.size())
+            return initialTerms[n];
+
+        const size_t length = coefficients.size();
+        if (length == 0)
+            return 0;
+
+        std::vector<uint64_t> result(length, 0);
+        std::vector<uint64_t> base(length, 0);
+        result[0] = 1;
+
+        if (length == 1)
+            base[0] = coefficients[0];
+        else
+            base[1] = 1;
+
+        for (; n > 0; n >>= 1)
+        {
+            if (n & 1)
+                result = multiplyModCharacteristic(result, base);
+            base = multiplyModCharacteristic(base, base);
+        }
+
+        uint64_t term = 0;
+        for (size_t i = 0; i < length; i++)
+            term = (term + result[i] * initialTerms[i]) % MODULUS;
+        return term;
     }
 
-    size_t part2()
+private:
+    std::vector<uint64_t> multiplyModCharacteristic(std::vector<uint64_t> const& a, std::vector<uint64_t> const& b) const
     {
-        return partCommon(75);
+        const size_t length = coefficients.size();
+        std::vector<uint64_t> product(2 * length - 1, 0);
+
+        for (size_t i = 0; i < length; i++)
+        {
+            if (a[i] == 0)
+                continue;
+
+            for (size_t j = 0; j < length; j++)
+                product[i + j] = (product[i + j] + a[i] * b[j]) % MODULUS;
+        }
+
+        // x^length = sum of coefficients[j] * x^(length - 1 - j)
+        for (size_t i = product.size() - 1; i >= length; i--)
+        {
+            const uint64_t top = product[i];
+            if (top == 0)
+                continue;
+
+            for (size_t j = 0; j < length; j++)
+                product[i - 1 - j] = (product[i - 1 - j] + top * coefficients[j]) % MODULUS;
+        }
+
+        product.resize(length);
+        return product;
+    }
+
+    static uint64_t inverse(uint64_t a)
+    {
+        // Fermat's little theorem, MODULUS is prime
+        uint64_t result = 1;
+        for (uint64_t e = MODULUS - 2; e > 0; e >>= 1)
+        {
+            if (e & 1)
+                result = result * a % MODULUS;
+            a = a * a % MODULUS;
+        }
+        return result;
+    }
+
+    std::vector<uint64_t> initialTerms;
+    std::vector<uint64_t> coefficients;
+};
+
+// Counts how many stones a stone turns into after a number of blinks.
+// Stone numbers are interned into dense ids, and the answer for every
+// (stone, number of blinks) pair is cached, so the work is shared between
+// all queries: later parts, other inputs and deeper blinks all reuse it.
+class StoneCounter
+{
+public:
+    size_t countAfterBlinks(std::vector<size_t> const& stones, size_t numBlinks)
+    {
+        std::vector<uint32_t> ids;
+        for (size_t stone : stones)
+            ids.push_back(intern(stone));
+
+        internDescendants();
+        extendLayersTo(numBlinks);
+
+        size_t total = 0;
+        for (uint32_t id : ids)
+            total += countAt(numBlinks, id);
+        return total;
+    }
+
+    // Number of stones after `numBlinks` blinks, modulo LinearRecurrence::MODULUS.
+    // Works for blink counts up to 10^18: the counts follow a linear recurrence
+    // no longer than the number of distinct stones, so twice that many terms
+    // (computed modulo the prime, two layers at a time) are enough to find it.
+    // Memory depends only on the number of distinct stones.
+    uint64_t countAfterBlinksModulo(std::vector<size_t> const& stones, uint64_t numBlinks)
+    {
+        std::vector<uint32_t> ids;
+        for (size_t stone : stones)
+            ids.push_back(intern(stone));
+
+        internDescendants();
+
+        const size_t numTerms = 2 * values.size();
+        std::vector<uint64_t> terms;
+        std::vector<uint64_t> layer(values.size(), 1);
+        std::vector<uint64_t> next(values.size());
+
+        for (size_t k = 0; k < numTerms && k <= numBlinks; k++)
+        {
+            uint64_t term = 0;
+            for (uint32_t id : ids)
+                term += layer[id];
+            terms.push_back(term % LinearRecurrence::MODULUS);
+
+            for (size_t id = 0; id < values.size(); id++)
+                next[id] = countFromChildren(layer.data(), id) % LinearRecurrence::MODULUS;
+
+            std::swap(layer, next);
+        }
+
+        if (numBlinks < terms.size())
+            return terms[numBlinks];
+
+        return LinearRecurrence(terms).nthTerm(numBlinks);
     }
 
 private:
-    void loadStonesFromFile()
+    static constexpr uint32_t NO_STONE = -1;
+
+    uint32_t intern(size_t stone)
     {
-        stoneNumToCount.clear();
+        auto [it, isNew] = stoneToId.try_emplace(stone, values.size());
+        if (isNew)
+            values.push_back(stone);
+        return it->second;
+    }
 
-        std::ifstream file(inputFilePath);
-        
-        if (!file)
+    // Interns the children of every stone until the set is closed under blinking.
+    // The stones reachable from real inputs form a small closed set, so this stops
+    // after a few thousand stones. Layers computed before are then filled in for
+    // the new stones, so every layer always covers every known stone.
+    void internDescendants()
+    {
+        const size_t firstNew = children.size();
+
+        for (size_t id = firstNew; id < values.size(); id++)
         {
-            std::cerr << "Could not open input file" << std::endl;
+            const auto [left, right] = blink(values[id]);
+            const uint32_t leftId = intern(left);
+            const uint32_t rightId = right.has_value() ? intern(*right) : NO_STONE;
+            children.push_back({ leftId, rightId });
+        }
+
+        if (values.size() == stride)
             return;
+
+        const size_t newStride = values.size();
+        numLayers = std::max<size_t>(numLayers, 1);
+
+        std::vector<size_t> relaidCounts(numLayers * newStride);
+        for (size_t k = 0; k < numLayers; k++)
+        {
+            std::copy_n(counts.data() + k * stride, stride, relaidCounts.data() + k * newStride);
+
+            for (size_t id = firstNew; id < newStride; id++)
+                relaidCounts[k * newStride + id] = k == 0 ? 1 : countFromChildren(relaidCounts.data() + (k - 1) * newStride, id);
         }
 
-        size_t number;
-        while (file >> number)
-            stoneNumToCount[number]++;
+        counts = std::move(relaidCounts);
+        stride = newStride;
     }
 
-    size_t partCommon(size_t numIterations)
+    // The table is grown once up front, so the blinks themselves never allocate.
+    void extendLayersTo(size_t numBlinks)
     {
-        loadStonesFromFile();
+        if (numLayers > numBlinks)
+            return;
+
+        counts.resize((numBlinks + 1) * stride);
 
-        for (size_t i = 0; i < numIterations; i++)
+        for (; numLayers <= numBlinks; numLayers++)
         {
-            updateStones();
+            size_t const* previous = counts.data() + (numLayers - 1) * stride;
+            size_t* current = counts.data() + numLayers * stride;
+
+            for (size_t id = 0; id < stride; id++)
+                current[id] = countFromChildren(previous, id);
         }
-        
-        return getStoneCount();
     }
 
-    void updateStones()
+    size_t countAt(size_t numBlinks, uint32_t id) const
     {
-        std::unordered_map<size_t, size_t> newStones;
+        return counts[numBlinks * stride + id];
+    }
 
-        for (auto const [number, count] : stoneNumToCount)
-        {
-            if (number == 0)
-            {
-                newStones[1] += count;
-                continue;
-            }
+    template <typename Count>
+    Count countFromChildren(Count const* previousLayer, size_t id) const
+    {
+        const auto [left, right] = children[id];
+        return previousLayer[left] + (right == NO_STONE ? 0 : previousLayer[right]);
+    }
 
-            size_t numLength = numDigits(number);
+    // returns the stones `number` turns into; there is no second one if it does not split
+    std::pair<size_t, std::optional<size_t>> blink(size_t number) const
+    {
+        if (number == 0)
+            return { 1, std::nullopt };
 
-            if (numLength % 2 == 1)
-            {
-                newStones[number * 2024] += count;
-            }
-            else
-            {
-                const size_t power = nthPowerOf10(numLength / 2);
-                const size_t leftPart = number / power;
-                const size_t rightPart = number % power;
+        const size_t numLength = numDigits(number);
 
-                newStones[leftPart] += count;
-                newStones[rightPart] += count;
-            }
+        if (numLength % 2 == 1)
+            return { number * 2024, std::nullopt };
+
+        const size_t power = nthPowerOf10(numLength / 2);
+        return { number / power, number % power };
+    }
+
+    static constexpr std::array<size_t, 20> POWERS_OF_10 = [] {
+        std::array<size_t, 20> powers {};
+        powers[0] = 1;
+        for (size_t i = 1; i < powers.size(); i++)
+            powers[i] = powers[i - 1] * 10;
+        return powers;
+    }();
+
+    // fewest decimal digits a number with the given bit length can have
+    static constexpr std::array<uint8_t, 65> MIN_DIGITS_FOR_BIT_LENGTH = [] {
+        std::array<uint8_t, 65> digits {};
+        digits[0] = 1;
+        for (size_t bits = 1; bits < digits.size(); bits++)
+        {
+            const size_t smallest = size_t(1) << (bits - 1);
+            uint8_t count = 1;
+            while (count < POWERS_OF_10.size() && smallest >= POWERS_OF_10[count])
+                count++;
+            digits[bits] = count;
         }
+        return digits;
+    }();
+
+    // a number of a given bit length has one of two digit counts, so one comparison decides
+    size_t numDigits(size_t n) const
+    {
+        const uint8_t minDigits = MIN_DIGITS_FOR_BIT_LENGTH[std::bit_width(n)];
+        return minDigits + (minDigits < POWERS_OF_10.size() && n >= POWERS_OF_10[minDigits]);
+    }
 
-        stoneNumToCount = std::move(newStones);
+    size_t nthPowerOf10(size_t n) const
+    {
+        return POWERS_OF_10[n];
     }
 
-    size_t numDigits(size_t n)
+    std::unordered_map<size_t, uint32_t> stoneToId;
+    std::vector<size_t> values;
+    std::vector<std::array<uint32_t, 2>> children;
+
+    // counts[k * stride + id] is the number of stones stone `id` turns into after k blinks
+    std::vector<size_t> counts;
+    size_t numLayers = 0;
+    size_t stride = 0;
+};
+
+class Solution
+{
+public:
+    void loadInputFromFile(const char* path)
     {
-        size_t powerOf10 = 10;
-        size_t numDigits = 1;
-        while (n >= powerOf10)
+        stones.clear();
+
+        std::ifstream file(path);
+        
+        if (!file)
         {
-            numDigits++;
-            powerOf10 *= 10;
+            std::cerr << "Could not open input file" << std::endl;
+            return;
         }
-        return numDigits;
+
+        size_t number;
+        while (file >> number)
+            stones.push_back(number);
     }
 
-    size_t nthPowerOf10(size_t n)
+    size_t part1()
     {
-        size_t result = 1;
-        while (n--)
-            result *= 10;
-        return  result;
+        return counter.countAfterBlinks(stones, 25);
     }
 
-    size_t getStoneCount() const
+    size_t part2()
     {
-        size_t total = 0;
-        for (const auto [number, count] : stoneNumToCount)
-            total += count;
-        return total;
+        return counter.countAfterBlinks(stones, 75);
     }
 
-    std::string inputFilePath;
-    std::unordered_map<size_t, size_t> stoneNumToCount;
+    uint64_t countAfterBlinksModulo(uint64_t numBlinks)
+    {
+        return counter.countAfterBlinksModulo(stones, numBlinks);
+    }
+
+private:
+    std::vector<size_t> stones;
+    StoneCounter counter;
 };
 
 int main()
 {
     Solution solution;
-    solution.setInputFilePath("../input.txt");
+    solution.loadInputFromFile("../input.txt");
 
     std::cout << solution.part1() << std::endl;
     std::cout << solution.part2() << std::endl;
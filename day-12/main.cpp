@@ -1,112 +1,81 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <unordered_set>
-#include <array>
-#include <functional>
+#include <string>
+#include <cstdint>
 #include <algorithm>
+#include <bit>
+#include <array>
+#include <thread>
 
-struct Position
+struct Region
 {
-    int x;
-    int y;
+    size_t area = 0;
+    size_t perimeter = 0;
+    size_t numSides = 0;
 
-    bool operator==(const Position& other) const
+    size_t getArea() const
     {
-        return x == other.x && y == other.y;
+        return area;
     }
 
-    static constexpr std::array<Position, 4> getPositionDeltas()
+    size_t getPerimeter() const
     {
-        return {{ {0, -1}, {1, 0}, {0, 1}, {-1, 0} }};
+        return perimeter;
     }
-};
 
-namespace std
-{
-    template <>
-    struct hash<Position>
+    size_t getNumSides() const
     {
-        size_t operator()(Position const& p) const
-        {
-            return (size_t)p.x << 32 | (size_t)p.y;
-        }
-    };
-}
+        return numSides;
+    }
+};
 
-struct Region
+// Union-find over provisional labels, with union by index and path halving.
+class DisjointSets
 {
-    std::unordered_set<Position> positions;
-
-    size_t getArea() const
+public:
+    uint32_t makeSet()
     {
-        return positions.size();
+        parent.push_back(parent.size());
+        return parent.back();
     }
 
-    size_t getPerimeter() const
+    uint32_t find(uint32_t x)
     {
-        size_t perimeter = 0;
-        for (auto const pos : positions)
+        while (parent[x] != x)
         {
-            for (auto const [dx, dy] : Position::getPositionDeltas())
-                perimeter += 1 - positions.count({pos.x + dx, pos.y + dy});
+            parent[x] = parent[parent[x]];
+            x = parent[x];
         }
-        return perimeter;
+        return x;
     }
 
-    size_t getNumSides() const
+    // the smaller label becomes the root, so roots stay in raster order
+    void unite(uint32_t a, uint32_t b)
     {
-        size_t numSides = 0;
-
-        auto processSlice = [this, &numSides] (int constant, int start, int end, int dx, int dy, bool isHorizontal) {
-            bool wasOnEdge = false;
-            for (int pos = start; pos <= end; pos++)
-            {
-                const int x = isHorizontal ? pos : constant;
-                const int y = isHorizontal ? constant : pos;
-
-                const bool isInside = positions.count({x, y});
-                const bool isNeighbourInside = positions.count({x+dx, y+dy});
-                const bool isOnEdge = isInside && !isNeighbourInside;
-                
-                if (isOnEdge && !wasOnEdge)
-                    numSides++;
-
-                wasOnEdge = isOnEdge;
-            }
-        };
-
-        for (auto const [dx, dy] : Position::getPositionDeltas())
-        {
-            const auto [minX, maxX] = getExtremesX();
-            const auto [minY, maxY] = getExtremesY();
-
-            if (dx == 0)
-            {
-                for (int y = minY; y <= maxY; y++)
-                    processSlice(y, minX, maxX, dx, dy, true);
-            }
-            else // dy = 0
-            {
-                for (int x = minX; x <= maxX; x++)
-                    processSlice(x, minY, maxY, dx, dy, false);
-            }
-        }
+        a = find(a);
+        b = find(b);
 
-        return numSides;
+        if (a < b)
+            parent[b] = a;
+        else if (b < a)
+            parent[a] = b;
     }
 
-    std::pair<int, int> getExtremesX() const
+    size_t size() const
     {
-        auto minmax = std::minmax_element(positions.begin(), positions.end(), [] (Position const& a, Position const& b) { return a.x < b.x; });
-        return { minmax.first->x, minmax.second->x };
+        return parent.size();
     }
 
-    std::pair<int, int> getExtremesY() const
-    {
-        auto minmax = std::minmax_element(positions.begin(), positions.end(), [] (Position const& a, Position const& b) { return a.y < b.y; });
-        return { minmax.first->y, minmax.second->y };
-    }
+private:
+    std::vector<uint32_t> parent;
+};
+
+// Region label of every plot (row by row), plus the statistics of every region.
+struct RegionLabels
+{
+    std::vector<uint32_t> labelOfPlot;
+    std::vector<Region> regions;
 };
 
 class Farm
@@ -135,61 +104,270 @@ public:
         }
     }
 
-    std::vector<Region> getRegions() const
+    // Connected-component labelling in horizontal tiles, one per core.
+    // Every tile first labels its own rows with its own union-find: each plot
+    // gets the label of its left or upper neighbour with the same plant (or a
+    // new label), noting when both exist but differ. The tiles' labels are then
+    // put into one union-find, with the plots on both sides of every seam
+    // between tiles united. Finally every tile, in parallel again, replaces its
+    // labels with region ids and counts area, perimeter and corners.
+    RegionLabels labelRegions() const
     {
-        std::vector<Region> regions;
-        std::unordered_set<Position> visitedPositions;
-        
-        for (int y = 0; y < height; y++)
+        RegionLabels result;
+        std::vector<uint32_t>& labels = result.labelOfPlot;
+        labels.resize(map.size());
+
+        // no more tiles than rows, so every tile has at least one row
+        const int numTiles = std::clamp<int>(std::thread::hardware_concurrency(), 1, std::max(height, 1));
+        std::vector<Tile> tiles(numTiles);
+        for (int t = 0; t < numTiles; t++)
         {
-            for (int x = 0; x < width; x++)
+            tiles[t].firstRow = height * t / numTiles;
+            tiles[t].endRow = height * (t + 1) / numTiles;
+        }
+
+        runInParallel(numTiles, [&] (int t) {
+            labelTileProvisionally(tiles[t], labels);
+        });
+
+        const std::vector<uint32_t> regionOfLabel = mergeTiles(tiles, labels);
+        result.regions.resize(tiles.back().endRegion);
+
+        runInParallel(numTiles, [&] (int t) {
+            Tile const& tile = tiles[t];
+            for (size_t idx = tile.firstRow * width; idx < tile.endRow * width; idx++)
+                labels[idx] = regionOfLabel[tile.firstLabel + labels[idx]];
+        });
+
+        runInParallel(numTiles, [&] (int t) {
+            countTileStatistics(tiles[t], t == numTiles - 1, result);
+        });
+
+        // regions crossing a seam were counted by several tiles
+        for (Tile const& tile : tiles)
+        {
+            for (size_t slot = 0; slot < tile.foreignRegions.size(); slot++)
             {
-                if (visitedPositions.count({x, y}))
-                    continue;
-                
-                Region currentRegion = getRegionContaining({x, y});
-
-                for (auto pos : currentRegion.positions)
-                    visitedPositions.insert(pos);
-                
-                regions.emplace_back(std::move(currentRegion));
+                Region& region = result.regions[tile.foreignRegions[slot]];
+                Region const& part = tile.foreignStatistics[slot];
+
+                region.area += part.area;
+                region.perimeter += part.perimeter;
+                region.numSides += part.numSides;
             }
         }
 
-        return regions;
+        return result;
     }
 
 private:
-    char at(Position p) const
+    static constexpr std::array<std::pair<int, int>, 4> DELTAS {{ {0, -1}, {1, 0}, {0, 1}, {-1, 0} }};
+    static constexpr uint32_t NO_REGION = -1;
+
+    struct Tile
     {
-        if (p.x < 0 || p.x >= width || p.y < 0 || p.y >= height)
-            return 0;
+        // rows [firstRow, endRow) of the map
+        size_t firstRow = 0;
+        size_t endRow = 0;
+
+        DisjointSets provisional;
+        uint32_t firstLabel = 0;
 
-        return map[p.y * width + p.x];
+        // the regions whose ids are assigned from this tile's labels
+        uint32_t firstRegion = 0;
+        uint32_t endRegion = 0;
+
+        // regions assigned elsewhere that reach this tile, sorted, and what the tile counted for them
+        std::vector<uint32_t> foreignRegions;
+        std::vector<Region> foreignStatistics;
+    };
+
+    void labelTileProvisionally(Tile& tile, std::vector<uint32_t>& labels) const
+    {
+        for (size_t y = tile.firstRow; y < tile.endRow; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                const size_t idx = y * width + x;
+                const bool sameAsLeft = x > 0 && map[idx - 1] == map[idx];
+                const bool sameAsUp = y > tile.firstRow && map[idx - width] == map[idx];
+
+                if (sameAsLeft && sameAsUp)
+                {
+                    labels[idx] = labels[idx - 1];
+                    tile.provisional.unite(labels[idx - 1], labels[idx - width]);
+                }
+                else if (sameAsLeft)
+                    labels[idx] = labels[idx - 1];
+                else if (sameAsUp)
+                    labels[idx] = labels[idx - width];
+                else
+                    labels[idx] = tile.provisional.makeSet();
+            }
+        }
     }
 
-    Region getRegionContaining(Position pos) const
+    // Puts the tiles' labels into one label space, unites the regions across
+    // seams, and returns the region id of every label in that space.
+    std::vector<uint32_t> mergeTiles(std::vector<Tile>& tiles, std::vector<uint32_t> const& labels) const
     {
-        Region region;
-        const char targetChar = at(pos);
-        
-        floodFillFrom(pos, targetChar, region);
+        DisjointSets merged;
+
+        for (Tile& tile : tiles)
+        {
+            tile.firstLabel = merged.size();
+            for (uint32_t label = 0; label < tile.provisional.size(); label++)
+            {
+                merged.makeSet();
+                merged.unite(tile.firstLabel + label, tile.firstLabel + tile.provisional.find(label));
+            }
+        }
+
+        // every tile has at least one row, so the tile above a seam is always the previous one
+        for (size_t t = 1; t < tiles.size(); t++)
+        {
+            const size_t y = tiles[t].firstRow;
+
+            for (int x = 0; x < width; x++)
+            {
+                const size_t idx = y * width + x;
+                if (map[idx] == map[idx - width])
+                    merged.unite(tiles[t].firstLabel + labels[idx], tiles[t - 1].firstLabel + labels[idx - width]);
+            }
+        }
+
+        // roots are the smallest label in their set, so they are met first in label order,
+        // and the regions rooted in one tile get consecutive ids
+        std::vector<uint32_t> regionOfLabel(merged.size());
+        uint32_t numRegions = 0;
+
+        for (Tile& tile : tiles)
+        {
+            tile.firstRegion = numRegions;
+            for (uint32_t label = tile.firstLabel; label < tile.firstLabel + tile.provisional.size(); label++)
+            {
+                const uint32_t root = merged.find(label);
+                regionOfLabel[label] = root == label ? numRegions++ : regionOfLabel[root];
+            }
+            tile.endRegion = numRegions;
+        }
 
-        return region;
+        return regionOfLabel;
     }
 
-    void floodFillFrom(Position pos, char target, Region& currentRegion) const
+    // Counts area and perimeter of the tile's plots, and the corners in the 2x2
+    // windows whose bottom row is in the tile (the last tile also takes the
+    // windows hanging off the bottom of the map). Regions assigned to this tile
+    // are written directly, as no other tile owns them. Foreign regions can only
+    // get here through the top seam, so they are all found on the two rows
+    // around it and get a private counter each.
+    void countTileStatistics(Tile& tile, bool isLastTile, RegionLabels& result) const
     {
-        if (at(pos) != target || currentRegion.positions.count(pos) > 0)
-            return;
-        
-        currentRegion.positions.insert(pos);
-        
-        for (auto const [dx, dy] : Position::getPositionDeltas())
+        for (size_t y = (tile.firstRow > 0 ? tile.firstRow - 1 : 0); y < std::min(tile.firstRow + 1, tile.endRow); y++)
         {
-            Position newPos = { pos.x + dx, pos.y + dy };
-            floodFillFrom(newPos, target, currentRegion);
+            for (int x = 0; x < width; x++)
+            {
+                const uint32_t region = result.labelOfPlot[y * width + x];
+                if (region < tile.firstRegion || region >= tile.endRegion)
+                    tile.foreignRegions.push_back(region);
+            }
         }
+
+        std::sort(tile.foreignRegions.begin(), tile.foreignRegions.end());
+        tile.foreignRegions.erase(std::unique(tile.foreignRegions.begin(), tile.foreignRegions.end()), tile.foreignRegions.end());
+        tile.foreignStatistics.assign(tile.foreignRegions.size(), Region{});
+
+        auto statisticsOf = [&] (uint32_t region) -> Region& {
+            if (region >= tile.firstRegion && region < tile.endRegion)
+                return result.regions[region];
+
+            const auto it = std::lower_bound(tile.foreignRegions.begin(), tile.foreignRegions.end(), region);
+            return tile.foreignStatistics[it - tile.foreignRegions.begin()];
+        };
+
+        for (size_t y = tile.firstRow; y < tile.endRow + isLastTile; y++)
+        {
+            for (int x = 0; x <= width; x++)
+            {
+                if (x < width && y < tile.endRow)
+                {
+                    const size_t idx = y * width + x;
+
+                    Region& region = statisticsOf(result.labelOfPlot[idx]);
+                    region.area++;
+
+                    for (auto const& [dx, dy] : DELTAS)
+                        region.perimeter += at(x + dx, y + dy) != map[idx];
+                }
+
+                countCorners(result, x, y, statisticsOf);
+            }
+        }
+    }
+
+    // A region has as many sides as corners. Looks at the 2x2 window of plots
+    // whose bottom-right plot is (x, y) and counts the corners every region
+    // has at the window's centre point: one if the region covers one or three
+    // of the plots, two if it covers two diagonally opposite plots.
+    template <typename StatisticsOf>
+    void countCorners(RegionLabels const& result, int x, int y, StatisticsOf const& statisticsOf) const
+    {
+        const std::array<uint32_t, 4> window = {
+            labelAt(result, x - 1, y - 1), labelAt(result, x, y - 1),
+            labelAt(result, x - 1, y),     labelAt(result, x, y),
+        };
+
+        for (int i = 0; i < 4; i++)
+        {
+            const uint32_t label = window[i];
+
+            // every region is handled once, at its first plot in the window
+            if (label == NO_REGION || std::find(window.begin(), window.begin() + i, label) != window.begin() + i)
+                continue;
+
+            int mask = 0;
+            for (int j = i; j < 4; j++)
+                mask |= (window[j] == label) << j;
+
+            const int numPlots = std::popcount(static_cast<unsigned>(mask));
+            const bool isDiagonal = mask == 0b1001 || mask == 0b0110;
+
+            if (numPlots == 1 || numPlots == 3)
+                statisticsOf(label).numSides += 1;
+            else if (isDiagonal)
+                statisticsOf(label).numSides += 2;
+        }
+    }
+
+    uint32_t labelAt(RegionLabels const& result, int x, int y) const
+    {
+        if (x < 0 || x >= width || y < 0 || y >= height)
+            return NO_REGION;
+
+        return result.labelOfPlot[y * width + x];
+    }
+
+    template <typename Work>
+    static void runInParallel(int numTasks, Work const& work)
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numTasks; t++)
+        {
+            threads.emplace_back(work, t);
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    char at(int x, int y) const
+    {
+        if (x < 0 || x >= width || y < 0 || y >= height)
+            return 0;
+
+        return map[y * width + x];
     }
 
     std::vector<char> map;
@@ -203,6 +381,7 @@ public:
     void loadInputFromFile(const char* path)
     {
         farm.loadFromFile(path);
+        regions = farm.labelRegions().regions;
     }
 
     size_t part1() const
@@ -216,10 +395,11 @@ public:
     }
 
 private:
-    size_t partCommon(std::function<size_t(Region const&)> price) const
+    template <typename Price>
+    size_t partCommon(Price const& price) const
     {
         size_t sum = 0;
-        for (auto r : farm.getRegions())
+        for (Region const& r : regions)
         {
             sum += price(r);
         }
@@ -237,6 +417,7 @@ private:
     }
 
     Farm farm;
+    std::vector<Region> regions;
 };
 
 int main()
@@ -1,8 +1,13 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <regex>
+#include <cmath>
 #include <optional>
+#include <tuple>
+#include <algorithm>
+#include <string>
+#include <iterator>
+#include <cctype>
 
 struct vec2l
 {
@@ -18,117 +23,272 @@ struct vec2l
     {
         return x == other.x && y == other.y;
     }
+};
+
+
+// The machines are kept as structure of arrays, one array per coefficient,
+// so solving all of them is one branch-free loop over contiguous data that
+// the compiler can vectorise. The target shift is stored separately and
+// applied while solving, so moving the targets never touches the machines.
+class Arcade
+{
+public:
+    static constexpr long long PRICE_A = 3;
+    static constexpr long long PRICE_B = 1;
 
-    static vec2l fromString(std::string const& string)
+    void loadFromFile(const char* path)
     {
-        std::regex twoNumbersRegex(R"((\d+).*?(\d+))");
+        std::ifstream file(path);
 
-        std::smatch match;
-        std::regex_search(string, match, twoNumbersRegex);
+        if (!file)
+        {
+            std::cerr << "Could not open file" << std::endl;
+            return;
+        }
 
-        return vec2l { std::stoll(match[1].str()), std::stoll(match[2].str()) };
+        const std::string text(std::istreambuf_iterator<char>(file), {});
+        parseMachines(text);
     }
-};
 
+    // Cramer's rule on every machine. Integer division has no SIMD form, so
+    // the press counts are estimated in floating point and then checked exactly
+    // with integer multiplication; a machine without an integer solution adds 0.
+    // That is only exact while every product fits a double's 53-bit mantissa,
+    // so the few machines outside that range, and those with collinear buttons,
+    // are left to a scalar 128-bit solver.
+    size_t totalCostOfWinningAllMachines() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < buttonAX.size(); i++)
+        {
+            const long long shiftedTargetX = targetX[i] + targetShift.x;
+            const long long shiftedTargetY = targetY[i] + targetShift.y;
+
+            // machines outside the fast range are zeroed before any arithmetic,
+            // so nothing here can overflow and they come out as unwinnable
+            const long long isFast = isInFastRange(buttonAX[i], buttonAY[i], buttonBX[i], buttonBY[i], shiftedTargetX, shiftedTargetY);
+            const long long xa = buttonAX[i] * isFast;
+            const long long ya = buttonAY[i] * isFast;
+            const long long xb = buttonBX[i] * isFast;
+            const long long yb = buttonBY[i] * isFast;
+            const long long xt = shiftedTargetX * isFast;
+            const long long yt = shiftedTargetY * isFast;
+
+            const long long det  = xa*yb - xb*ya;
+            const long long detA = xt*yb - yt*xb;
+            const long long detB = yt*xa - ya*xt;
+
+            const long long safeDet = det + (det == 0);
+            const long long pressesA = roundToInteger(static_cast<double>(detA) / safeDet);
+            const long long pressesB = roundToInteger(static_cast<double>(detB) / safeDet);
+
+            // bitwise rather than logical operators keep the loop free of branches
+            const bool isWinnable = (det != 0)
+                                  & (pressesA * det == detA) & (pressesB * det == detB)
+                                  & (pressesA >= 0) & (pressesB >= 0);
+            total += isWinnable * (PRICE_A * pressesA + PRICE_B * pressesB);
+        }
 
-struct Button
-{
-    vec2l deltas;
-    int price = 0;
-};
+        for (size_t i = 0; i < buttonAX.size(); i++)
+        {
+            const long long xt = targetX[i] + targetShift.x;
+            const long long yt = targetY[i] + targetShift.y;
 
+            if (isInFastRange(buttonAX[i], buttonAY[i], buttonBX[i], buttonBY[i], xt, yt) && !areCollinear(i))
+                continue;
 
-class ClawMachine
-{
-public:
-    ClawMachine(std::string const& btnAstr, std::string const& btnBstr, std::string const& targetStr)
+            const auto price = getMinimumWinningPriceExactly(buttonAX[i], buttonAY[i], buttonBX[i], buttonBY[i], xt, yt);
+            total += price.value_or(0);
+        }
+
+        return total;
+    }
+
+    void moveTargets(vec2l shift)
     {
-        buttonA.deltas = vec2l::fromString(btnAstr);
-        buttonA.price = 3;
+        targetShift = targetShift + shift;
+    }
 
-        buttonB.deltas = vec2l::fromString(btnBstr);
-        buttonB.price = 1;
+private:
+    using int128 = __int128;
+
+    // every product of two coefficients stays below 2^52, so determinants and their quotients are exact in a double
+    static bool isInFastRange(long long xa, long long ya, long long xb, long long yb, long long xt, long long yt)
+    {
+        constexpr double LIMIT = 4503599627370496.0; // 2^52
+
+        const double maxButton = std::max(std::max(std::abs(double(xa)), std::abs(double(ya))), std::max(std::abs(double(xb)), std::abs(double(yb))));
+        const double maxTarget = std::max(std::abs(double(xt)), std::abs(double(yt)));
+
+        return (maxButton * maxButton < LIMIT) & (maxButton * maxTarget < LIMIT);
+    }
 
-        target = vec2l::fromString(targetStr);
+    bool areCollinear(size_t i) const
+    {
+        return int128(buttonAX[i]) * buttonBY[i] == int128(buttonBX[i]) * buttonAY[i];
     }
 
-    std::optional<size_t> getMinimumWinningPrice() const
+    // Solves a*A + b*B = T for non-negative press counts a and b with every product
+    // taken in 128 bits, including the case of collinear buttons, where there may
+    // be many solutions and the cheapest one is wanted.
+    static std::optional<size_t> getMinimumWinningPriceExactly(int128 xa, int128 ya, int128 xb, int128 yb, int128 xt, int128 yt)
     {
-        const long xa = buttonA.deltas.x;
-        const long ya = buttonA.deltas.y;
+        const int128 det = xa*yb - xb*ya;
+
+        if (det != 0)
+        {
+            const int128 detA = xt*yb - yt*xb;
+            const int128 detB = yt*xa - ya*xt;
+
+            if (detA % det != 0 || detB % det != 0)
+                return {};
 
-        const long xb = buttonB.deltas.x;
-        const long yb = buttonB.deltas.y;
-        
-        const long xt = target.x;
-        const long yt = target.y;
+            const int128 pressesA = detA / det;
+            const int128 pressesB = detB / det;
 
-        const long det = xa*yb - xb*ya;
-        const long detA = xt*yb - yt*xb;
-        const long detB = yt*xa - ya*xt;
+            if (pressesA < 0 || pressesB < 0)
+                return {};
 
-        if (det == 0 || detA % det != 0 || detB % det != 0)
+            return static_cast<size_t>(PRICE_A * pressesA + PRICE_B * pressesB);
+        }
+
+        // both buttons move along the same line, which the target has to be on as well
+        const bool isAZero = xa == 0 && ya == 0;
+        const int128 dirX = isAZero ? xb : xa;
+        const int128 dirY = isAZero ? yb : ya;
+
+        if (dirX == 0 && dirY == 0)
+            return xt == 0 && yt == 0 ? std::optional<size_t>(0) : std::nullopt;
+
+        if (dirX * yt != dirY * xt)
             return {};
-        
-        return buttonA.price * (detA / det) + buttonB.price * (detB / det);
+
+        // on that line, one coordinate with movement along it determines the other
+        const bool useX = dirX != 0;
+        return getMinimumPriceOnLine(useX ? xa : ya, useX ? xb : yb, useX ? xt : yt);
     }
 
-    void moveTarget(vec2l shift)
+    // Cheapest a, b >= 0 with a*p + b*q = t. All solutions are
+    // (a0 + k*q/g, b0 - k*p/g) for g = gcd(p, q), the price is linear in k,
+    // so the cheapest one sits at an end of the range of k that keeps both counts non-negative.
+    static std::optional<size_t> getMinimumPriceOnLine(int128 p, int128 q, int128 t)
     {
-        target = target + shift;
-    }
+        if (p == 0 && q == 0)
+            return t == 0 ? std::optional<size_t>(0) : std::nullopt;
 
-private:
-    Button buttonA;
-    Button buttonB;
-    vec2l target;
-};
+        auto [g, x, y] = extendedGcd(p, q);
+        if (t % g != 0)
+            return {};
 
+        const int128 a0 = x * (t / g);
+        const int128 b0 = y * (t / g);
+        const int128 stepA = q / g;
+        const int128 stepB = -p / g;
+
+        // each count gives a bound on k: a0 + k*stepA >= 0 and b0 + k*stepB >= 0
+        std::optional<int128> minK, maxK;
+        auto addBound = [&] (int128 start, int128 step) {
+            if (step > 0)
+            {
+                const int128 bound = ceilDiv(-start, step);
+                minK = minK.has_value() ? std::max(*minK, bound) : bound;
+            }
+            else if (step < 0)
+            {
+                const int128 bound = floorDiv(start, -step);
+                maxK = maxK.has_value() ? std::min(*maxK, bound) : bound;
+            }
+            else if (start < 0)
+            {
+                minK = 1;
+                maxK = 0;
+            }
+        };
+        addBound(a0, stepA);
+        addBound(b0, stepB);
+
+        if (minK.has_value() && maxK.has_value() && *minK > *maxK)
+            return {};
 
-class Arcade
-{
-public:
-    void loadFromFile(const char* path)
+        // the price never drops below zero, so it can only fall towards a bounded end
+        const int128 priceStep = PRICE_A * stepA + PRICE_B * stepB;
+        const int128 k = priceStep > 0 ? minK.value_or(0) : priceStep < 0 ? maxK.value_or(0) : minK.value_or(maxK.value_or(0));
+
+        return static_cast<size_t>(PRICE_A * (a0 + k * stepA) + PRICE_B * (b0 + k * stepB));
+    }
+
+    static std::tuple<int128, int128, int128> extendedGcd(int128 a, int128 b)
     {
-        std::ifstream file(path);
+        if (b == 0)
+            return a < 0 ? std::make_tuple(-a, int128(-1), int128(0)) : std::make_tuple(a, int128(1), int128(0));
 
-        if (!file)
-        {
-            std::cerr << "Could not open file" << std::endl;
-            return;
-        }
+        auto [g, x, y] = extendedGcd(b, a % b);
+        return { g, y, x - (a / b) * y };
+    }
 
-        std::string btnA, btnB, target, empty;
-        do
-        {
-            std::getline(file, btnA);
-            std::getline(file, btnB);
-            std::getline(file, target);
-            std::getline(file, empty);
+    static int128 floorDiv(int128 a, int128 b)
+    {
+        return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+    }
 
-            machines.emplace_back(btnA, btnB, target);
-        } while (file);
+    static int128 ceilDiv(int128 a, int128 b)
+    {
+        return -floorDiv(-a, b);
     }
 
-    size_t totalCostOfWinningAllMachines() const
+    // unlike std::llround, this is not a library call, so it does not stop vectorisation
+    static long long roundToInteger(double value)
     {
-        size_t total = 0;
-        for (auto const& machine : machines)
+        return static_cast<long long>(value + std::copysign(0.5, value));
+    }
+
+    // Pulls the integers out of the text in one pass, ignoring everything else,
+    // and stores every six of them (button A, button B, prize) as one machine.
+    // Blank lines carry no numbers, so it does not matter whether the last
+    // machine is followed by one; an incomplete machine at the end is dropped.
+    void parseMachines(std::string const& text)
+    {
+        constexpr size_t NUMBERS_PER_MACHINE = 6;
+        long long numbers[NUMBERS_PER_MACHINE];
+        size_t numRead = 0;
+
+        for (size_t i = 0; i < text.size(); i++)
         {
-            auto price = machine.getMinimumWinningPrice();
-            total += price.value_or(0);
+            const bool isNegative = text[i] == '-' && i + 1 < text.size() && std::isdigit(static_cast<unsigned char>(text[i + 1]));
+            if (!isNegative && !std::isdigit(static_cast<unsigned char>(text[i])))
+                continue;
+
+            if (isNegative)
+                i++;
+
+            long long value = 0;
+            for (; i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])); i++)
+                value = value * 10 + (text[i] - '0');
+
+            numbers[numRead++] = isNegative ? -value : value;
+
+            if (numRead == NUMBERS_PER_MACHINE)
+            {
+                addMachine({ numbers[0], numbers[1] }, { numbers[2], numbers[3] }, { numbers[4], numbers[5] });
+                numRead = 0;
+            }
         }
-        return total;
     }
 
-    void moveTargets(vec2l shift)
+    void addMachine(vec2l buttonA, vec2l buttonB, vec2l target)
     {
-        for (auto& m : machines)
-            m.moveTarget(shift);
+        buttonAX.push_back(buttonA.x);
+        buttonAY.push_back(buttonA.y);
+        buttonBX.push_back(buttonB.x);
+        buttonBY.push_back(buttonB.y);
+        targetX.push_back(target.x);
+        targetY.push_back(target.y);
     }
 
-private:
-    std::vector<ClawMachine> machines;
+    std::vector<long long> buttonAX, buttonAY;
+    std::vector<long long> buttonBX, buttonBY;
+    std::vector<long long> targetX, targetY;
+    vec2l targetShift;
 };
 
 
@@ -1,72 +1,32 @@
 #include <iostream>
 #include <fstream>
 #include <regex>
-#include <unordered_set>
-#include <optional>
+#include <vector>
+#include <string>
+#include <utility>
 
-static constexpr long HALL_WIDTH = 101;
-static constexpr long HALL_HEIGHT = 103;
-
-struct vec2l
-{
-    long long x = 0;
-    long long y = 0;
-
-    vec2l operator+(vec2l const& other) const
-    {
-        return vec2l { x + other.x, y + other.y };
-    }
-
-    bool operator==(vec2l const& other) const
-    {
-        return x == other.x && y == other.y;
-    }
-};
-
-namespace std
-{
-    template<>
-    struct hash<vec2l>
-    {
-        size_t operator()(vec2l const& vec) const
-        {
-            return vec.x << 32 | vec.y;
-        }
-    };
-}
-
-struct Robot
-{
-    vec2l position;
-    vec2l velocity;
-
-    void move()
-    {
-        position = position + velocity;
-
-        position.x = (position.x + HALL_WIDTH) % HALL_WIDTH;
-        position.y = (position.y + HALL_HEIGHT) % HALL_HEIGHT;
-    }
-
-    void initFromString(std::string const& str)
-    {
-        std::regex number(R"(-?\d+)");
-
-        std::sregex_iterator it(str.begin(), str.end(), number);
-        position.x = std::stol((it++)->str());
-        position.y = std::stol((it++)->str());
-        velocity.x = std::stol((it++)->str());
-        velocity.y = std::stol((it++)->str());
-    }
-};
+static constexpr int HALL_WIDTH = 101;
+static constexpr int HALL_HEIGHT = 103;
 
+// Robots are stored as structure of arrays. Since every robot moves in a
+// straight line on a torus, its position after t seconds is (p + v*t) mod size,
+// so any time can be reached directly in one branch-free pass over all robots.
 struct BathroomHall
 {
-    std::vector<Robot> robots;
+    // velocities are kept reduced modulo the hall size, so they are never negative
+    std::vector<int> startX, startY;
+    std::vector<int> velocityX, velocityY;
+
+    // positions at the time of the last jump
+    std::vector<int> positionX, positionY;
 
     void loadFromFile(const char* path)
     {
-        robots.clear();
+        startX.clear();
+        startY.clear();
+        velocityX.clear();
+        velocityY.clear();
+
         std::ifstream file(path);
 
         if (!file)
@@ -75,32 +35,59 @@ struct BathroomHall
             return;
         }
 
+        std::regex number(R"(-?\d+)");
+
         std::string line;
         while (std::getline(file, line))
         {
-            Robot robot;
-            robot.initFromString(line);
-            robots.push_back(std::move(robot));
+            std::sregex_iterator it(line.begin(), line.end(), number);
+            startX.push_back(std::stol((it++)->str()));
+            startY.push_back(std::stol((it++)->str()));
+            velocityX.push_back(reduce(std::stol((it++)->str()), HALL_WIDTH));
+            velocityY.push_back(reduce(std::stol((it++)->str()), HALL_HEIGHT));
         }
+
+        jumpTo(0);
     }
 
-    size_t getProductOfQuadrantCounts()
+    void jumpTo(long long seconds)
     {
-        constexpr long ITERATIONS = 100;
-        constexpr long NUM_QUADRANTS = 4;
+        positionX.resize(startX.size());
+        positionY.resize(startY.size());
 
-        size_t quadrants[NUM_QUADRANTS] = {};
+        // all operands are below the hall size, so the products fit an int and
+        // the modulo is by a constant, which GCC vectorises at -O3 (the default Release build)
+        const int tx = reduce(seconds, HALL_WIDTH);
+        const int ty = reduce(seconds, HALL_HEIGHT);
 
-        for (auto& robot : robots)
+        for (size_t i = 0; i < startX.size(); i++)
         {
-            for (long i = 0; i < ITERATIONS; i++)
-                robot.move();
+            positionX[i] = (startX[i] + velocityX[i] * tx) % HALL_WIDTH;
+            positionY[i] = (startY[i] + velocityY[i] * ty) % HALL_HEIGHT;
+        }
+    }
+
+    size_t getProductOfQuadrantCounts() const
+    {
+        static_assert(HALL_HEIGHT % 2 == 1);
+        static_assert(HALL_WIDTH % 2 == 1);
+
+        constexpr int middleRow = HALL_HEIGHT / 2;
+        constexpr int middleCol = HALL_WIDTH / 2;
 
-            auto quadrantIdx = getQuadrantIdx(robot.position);
-            if (quadrantIdx.has_value())
-                quadrants[quadrantIdx.value()]++;
+        // counted as sums of comparisons rather than histogram updates, so the loop stays vectorisable
+        size_t quadrants[4] = {};
+        for (size_t i = 0; i < positionX.size(); i++)
+        {
+            const int x = positionX[i];
+            const int y = positionY[i];
+
+            quadrants[0] += (x < middleCol) & (y < middleRow);
+            quadrants[1] += (x > middleCol) & (y < middleRow);
+            quadrants[2] += (x < middleCol) & (y > middleRow);
+            quadrants[3] += (x > middleCol) & (y > middleRow);
         }
-        
+
         size_t total = 1;
         for (auto q : quadrants)
         {
@@ -109,71 +96,67 @@ struct BathroomHall
         return total;
     }
 
-    void moveRobots()
+    // The picture is a dense cluster, so it shows up as the time of minimum
+    // positional variance on each axis. The x positions repeat every HALL_WIDTH
+    // seconds and the y positions every HALL_HEIGHT seconds, so each axis is
+    // searched separately and the two offsets are combined with the CRT.
+    long long findEasterEggTime() const
     {
-        for (auto& robot : robots)
-            robot.move();
+        const int tx = findTimeOfMinimumSpread<HALL_WIDTH>(startX, velocityX);
+        const int ty = findTimeOfMinimumSpread<HALL_HEIGHT>(startY, velocityY);
+
+        // t = tx + HALL_WIDTH * k, where HALL_WIDTH * k = ty - tx (mod HALL_HEIGHT)
+        const int k = reduce(static_cast<long long>(ty - tx) * inverseModulo(HALL_WIDTH, HALL_HEIGHT), HALL_HEIGHT);
+        return tx + static_cast<long long>(HALL_WIDTH) * k;
     }
 
-    size_t numRobotsWithAtLeast2Neighbours() const
+private:
+    template <int SIZE>
+    static int findTimeOfMinimumSpread(const std::vector<int>& start, const std::vector<int>& velocity)
     {
-        size_t num = 0;
-        for (Robot const& robot : robots)
+        int bestTime = 0;
+        long long bestSpread = -1;
+
+        for (int t = 0; t < SIZE; t++)
         {
-            size_t neigh = 0;
-            for (Robot const& other : robots)
+            // n * sum of squared deviations, kept in integers to avoid rounding
+            long long sum = 0;
+            long long sumOfSquares = 0;
+            for (size_t i = 0; i < start.size(); i++)
             {
-                int dx = robot.position.x - other.position.x;
-                int dy = robot.position.y - other.position.y;
+                const long long p = (start[i] + velocity[i] * t) % SIZE;
+                sum += p;
+                sumOfSquares += p * p;
+            }
+            const long long spread = static_cast<long long>(start.size()) * sumOfSquares - sum * sum;
 
-                if (dx == 0 && (dy == 1 || dy == -1) || dy == 0 && (dx == 1 || dx == -1))
-                {
-                    neigh++;
-                }
+            if (bestSpread < 0 || spread < bestSpread)
+            {
+                bestSpread = spread;
+                bestTime = t;
             }
-            if (neigh >= 2)
-                num++;
         }
-        return num;
+
+        return bestTime;
     }
 
-    void print() const
+    static long long inverseModulo(long long value, long long modulus)
     {
-        for (int y = 0; y < HALL_HEIGHT; y++)
+        // extended Euclid, the hall dimensions are coprime
+        long long oldR = value % modulus, r = modulus;
+        long long oldS = 1, s = 0;
+        while (r != 0)
         {
-            for (int x = 0; x < HALL_WIDTH; x++)
-            {
-                bool isRobotHere = false;
-                for (Robot const& r : robots)
-                {
-                    if (r.position.x == x && r.position.y == y)
-                    {
-                        isRobotHere = true;
-                        break;
-                    }
-                }
-                std::cout << (isRobotHere ? '#' : '.');
-            }
-            std::cout << "\n";
+            long long q = oldR / r;
+            oldR -= q * r; std::swap(oldR, r);
+            oldS -= q * s; std::swap(oldS, s);
         }
+        return reduce(oldS, modulus);
     }
 
-private:
-    std::optional<int> getQuadrantIdx(vec2l pos) const
+    static int reduce(long long value, long long modulus)
     {
-        static_assert(HALL_HEIGHT % 2 == 1);
-        static_assert(HALL_WIDTH % 2 == 1);
-
-        constexpr int middleRow = HALL_HEIGHT / 2;
-        constexpr int middleCol = HALL_WIDTH / 2;
-
-        if (pos.x == middleCol || pos.y == middleRow)
-            return {};
-        
-        const int x = pos.x < middleCol;
-        const int y = pos.y < middleRow;
-
-        return y * 2 + x;
+        return static_cast<int>((value % modulus + modulus) % modulus);
     }
 };
 
@@ -189,28 +172,14 @@ public:
     size_t part1()
     {
         hall.loadFromFile(inputPath.c_str());
+        hall.jumpTo(100);
         return hall.getProductOfQuadrantCounts();
     }
 
     size_t part2()
     {
         hall.loadFromFile(inputPath.c_str());
-
-        size_t seconds = 0;
-        size_t bestNeighbourhood = 0;
-        while (true)
-        {
-            size_t num2neighbours = hall.numRobotsWithAtLeast2Neighbours();
-            if (num2neighbours > bestNeighbourhood)
-            {
-                bestNeighbourhood = num2neighbours;
-                hall.print();
-                std::cout << "This is after " << seconds << " seconds.\n\n";
-            }
-            seconds++;
-            hall.moveRobots();
-        }
-        return seconds;
+        return hall.findEasterEggTime();
     }
 
 private: